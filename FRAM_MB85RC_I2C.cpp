@@ -19,6 +19,21 @@
 	v1.2.0 - Uses reinterpret_cast instead of bit shift / masking for performance. Breaks backward compatibility with previous code - See PR#6
 	v1.2.1 - Fix comment line #76 (issue #11), max address define statement for 512K & 1M chips (issue 13), 0b000XXXXXXXX on <64kb device (issue #10)
 	v1.3.0 - Fix access to las byte of memory map by @marmik18 - Commit 690a9ac
+	v1.4.0 - FRAM_BURST_SIZE burst length definition, compressed blob storage (FramBlob)
+	v1.4.1 - Optional shared bus locking for RTOS tasks (FRAM_THREAD_SAFE), request coalescing queue (FramBusQueue)
+	v1.4.2 - readBlock() & writeBlock() for any size transfers, crc16(), A/B double buffered records (FramABRecord)
+	v1.4.3 - Persistent slots allocator (FramSlabAllocator)
+	v1.4.4 - Windowed typed array, iterator & reference proxies (FramArray)
+	v1.4.5 - Stream / Print adapter (FramStream)
+	v1.4.6 - Scatter / gather readv() & writev()
+	v1.4.7 - Time series store (FramTimeSeries)
+	v1.4.8 - Pinned regions mirrored in RAM with write-through (pinRegion())
+	v1.4.9 - Batched write sessions (FramWriteSession) & software protection map (protectRange())
+	v1.4.10 - I2C controller selectable per instance (setWire()), mirrored / striped / concatenated chips (FramRaid)
+	v1.4.11 - Dirty ranges tracking & incremental export (exportDirty())
+	v1.4.12 - Bulk 16 / 32-bit arrays I/O with byte order conversion (readWords(), readLongs()...)
+	v1.4.13 - Access trace recorder (FRAM_TRACE_DEPTH) & host replay tool (extras/trace_replay.py)
+	v1.4.14 - Sleep mode with automatic wake-up & idle policy (sleep(), setAutoSleep(), sleepPoll())
 */
 /**************************************************************************/
 
@@ -26,6 +41,80 @@
 #include <Wire.h>
 #include "FRAM_MB85RC_I2C.h"
 
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+ #define FRAM_HOST_ORDER FRAM_BIG_ENDIAN
+#else
+ #define FRAM_HOST_ORDER FRAM_LITTLE_ENDIAN
+#endif
+
+// Byte swap kernels - a whole element per step, shifts & masks rather than byte moves
+static void framSwapWords(uint16_t values[], uint16_t count) {
+	for (uint16_t i = 0; i < count; i++) {
+		uint16_t x = values[i];
+		values[i] = (uint16_t)((x << 8) | (x >> 8));
+	}
+}
+
+static void framSwapLongs(uint32_t values[], uint16_t count) {
+	for (uint16_t i = 0; i < count; i++) {
+		uint32_t x = values[i];
+		x = ((x << 8) & 0xFF00FF00UL) | ((x >> 8) & 0x00FF00FFUL);
+		values[i] = (x << 16) | (x >> 16);
+	}
+}
+
+#if FRAM_THREAD_SAFE
+ #if defined(ESP32) || defined(ESP_PLATFORM)
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+
+// One mutex per bus, slots filled in order and never released
+static TwoWire * volatile framBusWire[FRAM_BUS_MAX];
+static SemaphoreHandle_t volatile framBusMutex[FRAM_BUS_MAX];
+static portMUX_TYPE framBusMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Mutex of a bus, created on first use. Tasks reaching the first lock of a bus together each
+// create a mutex, only the first one installed is kept. Past FRAM_BUS_MAX buses, the first mutex is shared :
+// once the table is full, a bus not found there gets it without creating anything.
+static SemaphoreHandle_t framBusMutexGet(TwoWire *wire) {
+	for (uint8_t i = 0; i < FRAM_BUS_MAX; i++) {
+		if ((framBusWire[i] == wire) && (framBusMutex[i] != NULL)) return framBusMutex[i];
+	}
+	if (framBusMutex[FRAM_BUS_MAX - 1] != NULL) return framBusMutex[0];
+	SemaphoreHandle_t created = xSemaphoreCreateRecursiveMutex();
+	SemaphoreHandle_t mutex = NULL;
+	portENTER_CRITICAL(&framBusMux);
+	for (uint8_t i = 0; (i < FRAM_BUS_MAX) && (mutex == NULL); i++) {
+		if (framBusWire[i] == wire) {
+			mutex = framBusMutex[i];
+		}
+		else if (framBusMutex[i] == NULL) {
+			framBusWire[i] = wire; // before its mutex : a slot with a mutex has its bus
+			framBusMutex[i] = created;
+			mutex = created;
+			created = NULL;
+		}
+	}
+	if (mutex == NULL) mutex = framBusMutex[0];
+	portEXIT_CRITICAL(&framBusMux);
+	if (created != NULL) vSemaphoreDelete(created);
+	return mutex;
+}
+static void framBusMutexTake(TwoWire *wire) {
+	xSemaphoreTakeRecursive(framBusMutexGet(wire), portMAX_DELAY);
+}
+static void framBusMutexGive(TwoWire *wire) {
+	xSemaphoreGiveRecursive(framBusMutexGet(wire));
+}
+
+static void (*framBusLockFn)(TwoWire *wire) = framBusMutexTake;
+static void (*framBusUnlockFn)(TwoWire *wire) = framBusMutexGive;
+ #else
+static void (*framBusLockFn)(TwoWire *wire) = NULL;	// no default lock on this platform, plug one with setBusLock()
+static void (*framBusUnlockFn)(TwoWire *wire) = NULL;
+ #endif
+#endif
+
 /*========================================================================*/
 /*                            CONSTRUCTORS                                */
 /*========================================================================*/
@@ -41,6 +130,7 @@ FRAM_MB85RC_I2C::FRAM_MB85RC_I2C(void)
 		_manualMode = false;
 		i2c_addr = MB85RC_DEFAULT_ADDRESS;
 		wpPin = DEFAULT_WP_PIN;
+		FRAM_MB85RC_I2C::initFeatures();
 		byte result = FRAM_MB85RC_I2C::initWP(DEFAULT_WP_STATUS);
 
 }
@@ -51,6 +141,7 @@ FRAM_MB85RC_I2C::FRAM_MB85RC_I2C(uint8_t address, boolean wp)
 		_manualMode = false;
 		i2c_addr = address;
 		wpPin = DEFAULT_WP_PIN;
+		FRAM_MB85RC_I2C::initFeatures();
 		byte result = FRAM_MB85RC_I2C::initWP(wp);
 }
 
@@ -60,6 +151,7 @@ FRAM_MB85RC_I2C::FRAM_MB85RC_I2C(uint8_t address, boolean wp, int pin)
 		_manualMode = false;
 		i2c_addr = address;
 		wpPin = pin;
+		FRAM_MB85RC_I2C::initFeatures();
 		byte result = FRAM_MB85RC_I2C::initWP(wp);
 		
 }
@@ -73,6 +165,7 @@ FRAM_MB85RC_I2C::FRAM_MB85RC_I2C(uint8_t address, boolean wp, int pin, uint16_t
 		wpPin = pin;
 		density = chipDensity;
 
+		FRAM_MB85RC_I2C::initFeatures();
 		byte result = FRAM_MB85RC_I2C::initWP(wp);
 		
 		
@@ -82,11 +175,35 @@ FRAM_MB85RC_I2C::FRAM_MB85RC_I2C(uint8_t address, boolean wp, int pin, uint16_t
 /*                           PUBLIC FUNCTIONS                             */
 /*========================================================================*/
 
-void FRAM_MB85RC_I2C::begin(void) {
+/**************************************************************************/
+/*!
+    @brief  Finds the chip and loads the pinned ranges. A pinned range that cannot be loaded
+			is unpinned - all of them when the chip is not found
+
+	@returns
+				  0: success
+				  7: device not found
+				  return code of the first pinned range failing to load
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::begin(void) {
 
-	
+	#if FRAM_THREAD_SAFE && (defined(ESP32) || defined(ESP_PLATFORM))
+		framBusMutexGet(_wire); // usually before the tasks sharing the bus start, safe from any task anyway
+	#endif
 	
 	byte deviceFound = FRAM_MB85RC_I2C::checkDevice();
+	byte result = deviceFound;
+	#if FRAM_PIN_MAX > 0
+		if (deviceFound == ERROR_0) {
+			result = FRAM_MB85RC_I2C::loadPinned();
+		}
+		else {
+			FRAM_MB85RC_I2C::busLock();
+			_pinCount = 0; // no mirror loaded, none can be served
+			FRAM_MB85RC_I2C::busUnlock();
+		}
+	#endif
 
     #if defined(SERIAL_DEBUG) && (SERIAL_DEBUG == 1)
 		if (!Serial) Serial.begin(9600);
@@ -114,7 +231,29 @@ void FRAM_MB85RC_I2C::begin(void) {
 		}
     #endif
 
-	return;
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Selects the I2C controller the chip is wired to, Wire by default. Call before begin(),
+			and not while the bus lock is held.
+
+    @params[in] wire
+                TwoWire object (Wire, Wire1...), started by the caller
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::setWire(TwoWire *wire) {
+	_wire = wire;
+}
+
+/**************************************************************************/
+/*!
+    @brief  I2C controller the chip is wired to
+*/
+/**************************************************************************/
+TwoWire *FRAM_MB85RC_I2C::getWire(void) {
+	return _wire;
 }
 
 /**************************************************************************/
@@ -133,6 +272,13 @@ byte FRAM_MB85RC_I2C::checkDevice(void)
 	}
 	else {
 		result = getDeviceIDs();
+		if (result == ERROR_2) {
+			// may be a chip left asleep by a previous run : wake it up & ask again
+			FRAM_MB85RC_I2C::busLock();
+			FRAM_MB85RC_I2C::wakeUp();
+			FRAM_MB85RC_I2C::busUnlock();
+			result = getDeviceIDs();
+		}
 	}
   
 	// 
@@ -161,18 +307,33 @@ byte FRAM_MB85RC_I2C::checkDevice(void)
                 The array of bytes to write
 	@returns
 				return code of Wire.endTransmission()
+				10: range in a protected range (protectRange()), the bus is not accessed
 */
 /**************************************************************************/
 byte FRAM_MB85RC_I2C::writeArray (uint16_t framAddr, byte items, uint8_t values[])
 {
 	if ((framAddr > maxaddress) || ((framAddr + (uint16_t) items - 1) > maxaddress)) return ERROR_11;
+	#if FRAM_PROTECT_MAX > 0
+		if ((_protCount > 0) && FRAM_MB85RC_I2C::isProtected(framAddr, items)) return ERROR_10;
+	#endif
 	
-	
+	FRAM_MB85RC_I2C::busLock();
+	#if FRAM_TRACE_DEPTH > 0
+		FRAM_MB85RC_I2C::traceRecord(FRAM_TRACE_WRITE, framAddr, items);
+	#endif
 	FRAM_MB85RC_I2C::I2CAddressAdapt(framAddr);
 	for (byte i=0; i < items ; i++) {
-		Wire.write(values[i]);
+		_wire->write(values[i]);
 	}
-	return Wire.endTransmission();
+	byte result = _wire->endTransmission();
+	#if FRAM_PIN_MAX > 0
+		if ((result == ERROR_0) && (_pinCount > 0)) FRAM_MB85RC_I2C::writePinned(framAddr, items, values);
+	#endif
+	#if FRAM_DIRTY_MAX > 0
+		if (result == ERROR_0) FRAM_MB85RC_I2C::markDirty(framAddr, items);
+	#endif
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
 }
 
 /**************************************************************************/
@@ -222,15 +383,229 @@ byte FRAM_MB85RC_I2C::readArray (uint16_t framAddr, byte items, uint8_t values[]
 	if (items == 0) {
 		result = ERROR_8; //number of bytes asked to read null
 	}
+	#if FRAM_PIN_MAX > 0
+	else if ((_pinCount > 0) && FRAM_MB85RC_I2C::readPinned(framAddr, items, values)) {
+		result = ERROR_0; //served from RAM mirror, no bus traffic
+	}
+	#endif
 	else {
+		FRAM_MB85RC_I2C::busLock();
+		#if FRAM_TRACE_DEPTH > 0
+			FRAM_MB85RC_I2C::traceRecord(FRAM_TRACE_READ, framAddr, items);
+		#endif
 		FRAM_MB85RC_I2C::I2CAddressAdapt(framAddr);
-		result = Wire.endTransmission();
+		result = _wire->endTransmission();
 		
-		Wire.requestFrom(i2c_addr, (uint8_t)items);
+		_wire->requestFrom(i2c_addr, (uint8_t)items);
 		for (byte i=0; i < items; i++) {
-			values[i] = Wire.read();
+			values[i] = _wire->read();
+		}
+		FRAM_MB85RC_I2C::busUnlock();
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads a block of any size, split in FRAM_BURST_SIZE transactions.
+			Bursts following the first one rely on the chip's current address latch, no address phase.
+
+    @params[in] framAddr
+                The 16-bit address to read from in FRAM memory
+	@params[in] items
+				number of items to read from memory chip
+	@params[out] values[]
+				array to be filled in by the memory read
+    @returns    
+				return code of Wire.endTransmission() of the first failing burst
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::readBlock (uint16_t framAddr, uint16_t items, uint8_t values[])
+{
+	if (items == 0) return ERROR_8;
+	if ((framAddr > maxaddress) || (((uint32_t)framAddr + items - 1) > maxaddress)) return ERROR_11;
+
+	byte result = ERROR_0;
+	uint16_t done = 0;
+	FRAM_MB85RC_I2C::busLock();
+	while ((done < items) && (result == ERROR_0)) {
+		byte n = ((items - done) > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (byte)(items - done);
+		if ((done == 0) || (density < 64) || FRAM_MB85RC_I2C::hasPinned()) {
+			result = FRAM_MB85RC_I2C::readArray(framAddr + done, n, &values[done]);
+		}
+		else {
+			#if FRAM_TRACE_DEPTH > 0
+				FRAM_MB85RC_I2C::traceRecord(FRAM_TRACE_LATCH, framAddr + done, n);
+			#endif
+			result = FRAM_MB85RC_I2C::readCurrent(n, &values[done]);
+		}
+		done += n;
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes a block of any size, split in FRAM_BURST_SIZE transactions.
+			The whole range is checked before the first byte is written.
+
+    @params[in] framAddr
+                The 16-bit address to write to in FRAM memory
+    @params[in] items
+                The number of items to write from the array
+	@params[in] values[]
+                The array of bytes to write
+	@returns
+				return code of Wire.endTransmission() of the first failing burst
+				10: range in a protected range - nothing is written
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::writeBlock (uint16_t framAddr, uint16_t items, uint8_t values[])
+{
+	if (items == 0) return ERROR_0;
+	if ((framAddr > maxaddress) || (((uint32_t)framAddr + items - 1) > maxaddress)) return ERROR_11;
+	#if FRAM_PROTECT_MAX > 0
+		if ((_protCount > 0) && FRAM_MB85RC_I2C::isProtected(framAddr, items)) return ERROR_10;
+	#endif
+
+	byte result = ERROR_0;
+	uint16_t done = 0;
+	while ((done < items) && (result == ERROR_0)) {
+		byte n = ((items - done) > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (byte)(items - done);
+		result = FRAM_MB85RC_I2C::writeArray(framAddr + done, n, &values[done]);
+		done += n;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Scatter read : fills several buffers from scattered addresses with the minimum number of transfers.
+			Entries are sorted by address, entries closer than gap bytes are merged in a single span
+			(filler bytes are read and dropped, cheaper than a new address phase).
+			Bursts following the first one of a span rely on the chip's current address latch, no address phase
+			(not when pinned ranges exist, a burst served from RAM leaves the latch behind).
+
+    @params[in,out] vec[]
+                Entries (address, number of bytes, buffer), in any order
+    @params[in] count
+                Number of entries, up to FRAM_IOV_MAX
+    @params[in] gap
+                Largest hole between two entries still read as filler
+    @returns    
+				return code of Wire.endTransmission() of the first failing transfer
+				8: an entry has a null length
+				10: too many entries
+				11: an entry is out of the memory map - nothing is read
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::readv (FramIOVec vec[], uint8_t count, uint16_t gap)
+{
+	uint8_t order[FRAM_IOV_MAX];
+	byte result = FRAM_MB85RC_I2C::sortIOVec(vec, count, order);
+	if (result != ERROR_0) return result;
+
+	uint8_t buffer[FRAM_BURST_SIZE];
+	FRAM_MB85RC_I2C::busLock();
+	uint8_t i = 0;
+	while ((i < count) && (result == ERROR_0)) {
+		// grow the span while the next entry starts within gap bytes
+		uint32_t start = vec[order[i]].framAddr;
+		uint32_t end = start + vec[order[i]].items;
+		uint8_t j = i + 1;
+		while (j < count) {
+			FramIOVec *e = &vec[order[j]];
+			if (e->framAddr > (end + gap)) break;
+			if (((uint32_t)e->framAddr + e->items) > end) end = (uint32_t)e->framAddr + e->items;
+			j++;
+		}
+
+		uint32_t pos = start;
+		while ((pos < end) && (result == ERROR_0)) {
+			byte n = ((end - pos) > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (byte)(end - pos);
+			if ((pos == start) || (density < 64) || FRAM_MB85RC_I2C::hasPinned()) {
+				result = FRAM_MB85RC_I2C::readArray((uint16_t)pos, n, buffer);
+			}
+			else {
+				#if FRAM_TRACE_DEPTH > 0
+					FRAM_MB85RC_I2C::traceRecord(FRAM_TRACE_LATCH, (uint16_t)pos, n);
+				#endif
+				result = FRAM_MB85RC_I2C::readCurrent(n, buffer);
+			}
+			for (uint8_t k = i; k < j; k++) {
+				FramIOVec *e = &vec[order[k]];
+				uint32_t lo = (e->framAddr > pos) ? e->framAddr : pos;
+				uint32_t hi = (uint32_t)e->framAddr + e->items;
+				if (hi > (pos + n)) hi = pos + n;
+				if (lo < hi) memcpy(&e->values[lo - e->framAddr], &buffer[lo - pos], hi - lo);
+			}
+			pos += n;
+		}
+		i = j;
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gather write : writes several buffers to scattered addresses.
+			Entries are sorted by address, adjacent entries are merged in the same bursts.
+
+    @params[in] vec[]
+                Entries (address, number of bytes, buffer), in any order - they must not overlap
+    @params[in] count
+                Number of entries, up to FRAM_IOV_MAX
+    @returns    
+				return code of Wire.endTransmission() of the first failing transfer
+				8: an entry has a null length
+				10: too many entries, overlapping entries or protected range - nothing is written
+				11: an entry is out of the memory map - nothing is written
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::writev (FramIOVec vec[], uint8_t count)
+{
+	uint8_t order[FRAM_IOV_MAX];
+	byte result = FRAM_MB85RC_I2C::sortIOVec(vec, count, order);
+	if (result != ERROR_0) return result;
+
+	for (uint8_t k = 1; k < count; k++) {
+		if (((uint32_t)vec[order[k - 1]].framAddr + vec[order[k - 1]].items) > vec[order[k]].framAddr) return ERROR_10;
+	}
+	#if FRAM_PROTECT_MAX > 0
+		for (uint8_t k = 0; (k < count) && (_protCount > 0); k++) {
+			if (FRAM_MB85RC_I2C::isProtected(vec[k].framAddr, vec[k].items)) return ERROR_10;
+		}
+	#endif
+
+	uint8_t buffer[FRAM_BURST_SIZE];
+	byte fill = 0;
+	uint16_t fillAddr = 0;
+	FRAM_MB85RC_I2C::busLock();
+	for (uint8_t k = 0; (k < count) && (result == ERROR_0); k++) {
+		FramIOVec *e = &vec[order[k]];
+		// not adjacent to the pending burst : send it
+		if ((fill > 0) && (((uint32_t)fillAddr + fill) != e->framAddr)) {
+			result = FRAM_MB85RC_I2C::writeArray(fillAddr, fill, buffer);
+			fill = 0;
+		}
+		uint16_t done = 0;
+		while ((done < e->items) && (result == ERROR_0)) {
+			if (fill == 0) fillAddr = e->framAddr + done;
+			uint16_t n = e->items - done;
+			if (n > (uint16_t)(FRAM_BURST_SIZE - fill)) n = FRAM_BURST_SIZE - fill;
+			memcpy(&buffer[fill], &e->values[done], n);
+			fill += n;
+			done += n;
+			if (fill == FRAM_BURST_SIZE) {
+				result = FRAM_MB85RC_I2C::writeArray(fillAddr, fill, buffer);
+				fill = 0;
+			}
 		}
 	}
+	if ((fill > 0) && (result == ERROR_0)) result = FRAM_MB85RC_I2C::writeArray(fillAddr, fill, buffer);
+	FRAM_MB85RC_I2C::busUnlock();
 	return result;
 }
 
@@ -272,8 +647,10 @@ byte FRAM_MB85RC_I2C::readByte (uint16_t framAddr, uint8_t *value)
 byte FRAM_MB85RC_I2C::copyByte (uint16_t origAddr, uint16_t destAddr) 
 {
 	uint8_t buffer[1];
+	FRAM_MB85RC_I2C::busLock();
 	byte result = FRAM_MB85RC_I2C::readByte(origAddr, buffer);
 	result = FRAM_MB85RC_I2C::writeByte(destAddr, buffer[0]);
+	FRAM_MB85RC_I2C::busUnlock();
 	return result;
 }
 
@@ -328,9 +705,11 @@ byte FRAM_MB85RC_I2C::setOneBit(uint16_t framAddr, uint8_t bitNb)
 	}
 	else {
 		uint8_t buffer[1];
+		FRAM_MB85RC_I2C::busLock();
 		result = FRAM_MB85RC_I2C::readArray(framAddr, 1, buffer);
 		bitSet(buffer[0], bitNb);
 		result = FRAM_MB85RC_I2C::writeArray(framAddr, 1, buffer);
+		FRAM_MB85RC_I2C::busUnlock();
 	}
 	return result;
 }
@@ -355,9 +734,11 @@ byte FRAM_MB85RC_I2C::clearOneBit(uint16_t framAddr, uint8_t bitNb)
 	}
 	else {
 		uint8_t buffer[1];
+		FRAM_MB85RC_I2C::busLock();
 		result = FRAM_MB85RC_I2C::readArray(framAddr, 1, buffer);
 		bitClear(buffer[0], bitNb);
 		result = FRAM_MB85RC_I2C::writeArray(framAddr, 1, buffer);
+		FRAM_MB85RC_I2C::busUnlock();
 	}
 	return result;
 }
@@ -382,6 +763,7 @@ byte FRAM_MB85RC_I2C::toggleBit(uint16_t framAddr, uint8_t bitNb)
 	}
 	else {
 		uint8_t buffer[1];
+		FRAM_MB85RC_I2C::busLock();
 		result = FRAM_MB85RC_I2C::readArray(framAddr, 1, buffer);
 		
 		if ( (buffer[0] & (1 << bitNb)) == (1 << bitNb) )
@@ -392,6 +774,7 @@ byte FRAM_MB85RC_I2C::toggleBit(uint16_t framAddr, uint8_t bitNb)
 			bitSet(buffer[0], bitNb);
 		}
 		result = FRAM_MB85RC_I2C::writeArray(framAddr, 1, buffer);
+		FRAM_MB85RC_I2C::busUnlock();
 	}
 	return result;
 }
@@ -470,6 +853,114 @@ byte FRAM_MB85RC_I2C::writeLong(uint16_t framAddr, uint32_t value)
 	return FRAM_MB85RC_I2C::writeArray(framAddr, 4, buffer);
 }
 /**************************************************************************/
+/*!
+    @brief  Reads an array of 16-bit values in FRAM_BURST_SIZE transactions, byte order converted in place
+
+    @params[in] framAddr
+                The 16-bit address to read from in FRAM memory
+    @params[in] count
+                Number of values
+	@params[out] values[]
+				values read
+    @params[in] order
+                Byte order in FRAM : FRAM_LITTLE_ENDIAN (readWord() order on Arduino targets) or FRAM_BIG_ENDIAN
+    @returns
+				return code of Wire.endTransmission() of the first failing burst
+				0: success, also when count is null (nothing read, as writeBlock())
+				11: range out of the memory map
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::readWords(uint16_t framAddr, uint16_t count, uint16_t values[], uint8_t order)
+{
+	if (count == 0) return ERROR_0;
+	if (count > 0x7FFF) return ERROR_11;
+
+	byte result = FRAM_MB85RC_I2C::readBlock(framAddr, count * 2, reinterpret_cast<uint8_t *>(values));
+	if ((result == ERROR_0) && (order != FRAM_HOST_ORDER)) framSwapWords(values, count);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes an array of 16-bit values in FRAM_BURST_SIZE transactions.
+			Values to convert are swapped burst by burst in a local buffer, values[] is left untouched.
+
+    @params[in] framAddr
+                The 16-bit address to write to in FRAM memory
+    @params[in] count
+                Number of values
+	@params[in] values[]
+				values to write
+    @params[in] order
+                Byte order in FRAM : FRAM_LITTLE_ENDIAN or FRAM_BIG_ENDIAN
+    @returns
+				return code of Wire.endTransmission() of the first failing burst
+				0: success, also when count is null (nothing written)
+				10: range in a protected range - nothing is written
+				11: range out of the memory map - nothing is written
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::writeWords(uint16_t framAddr, uint16_t count, uint16_t values[], uint8_t order)
+{
+	if (count > 0x7FFF) return ERROR_11;
+	if (order == FRAM_HOST_ORDER) return FRAM_MB85RC_I2C::writeBlock(framAddr, count * 2, reinterpret_cast<uint8_t *>(values));
+	return FRAM_MB85RC_I2C::writeSwapped(framAddr, count, 2, reinterpret_cast<uint8_t *>(values));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads an array of 32-bit values in FRAM_BURST_SIZE transactions, byte order converted in place
+
+    @params[in] framAddr
+                The 16-bit address to read from in FRAM memory
+    @params[in] count
+                Number of values
+	@params[out] values[]
+				values read
+    @params[in] order
+                Byte order in FRAM : FRAM_LITTLE_ENDIAN (readLong() order on Arduino targets) or FRAM_BIG_ENDIAN
+    @returns
+				return code of Wire.endTransmission() of the first failing burst
+				0: success, also when count is null (nothing read, as writeBlock())
+				11: range out of the memory map
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::readLongs(uint16_t framAddr, uint16_t count, uint32_t values[], uint8_t order)
+{
+	if (count == 0) return ERROR_0;
+	if (count > 0x3FFF) return ERROR_11;
+
+	byte result = FRAM_MB85RC_I2C::readBlock(framAddr, count * 4, reinterpret_cast<uint8_t *>(values));
+	if ((result == ERROR_0) && (order != FRAM_HOST_ORDER)) framSwapLongs(values, count);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes an array of 32-bit values in FRAM_BURST_SIZE transactions, values[] is left untouched
+
+    @params[in] framAddr
+                The 16-bit address to write to in FRAM memory
+    @params[in] count
+                Number of values
+	@params[in] values[]
+				values to write
+    @params[in] order
+                Byte order in FRAM : FRAM_LITTLE_ENDIAN or FRAM_BIG_ENDIAN
+    @returns
+				return code of Wire.endTransmission() of the first failing burst
+				0: success, also when count is null (nothing written)
+				10: range in a protected range - nothing is written
+				11: range out of the memory map - nothing is written
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::writeLongs(uint16_t framAddr, uint16_t count, uint32_t values[], uint8_t order)
+{
+	if (count > 0x3FFF) return ERROR_11;
+	if (order == FRAM_HOST_ORDER) return FRAM_MB85RC_I2C::writeBlock(framAddr, count * 4, reinterpret_cast<uint8_t *>(values));
+	return FRAM_MB85RC_I2C::writeSwapped(framAddr, count, 4, reinterpret_cast<uint8_t *>(values));
+}
+/**************************************************************************/
 /*!
     @brief  Reads the Manufacturer ID and the Product ID frm the IC
 
@@ -600,7 +1091,7 @@ byte FRAM_MB85RC_I2C::disableWP() {
 }
 /**************************************************************************/
 /*!
-    @brief  Erase device by overwriting it to 0x00
+    @brief  Erase device by overwriting it to 0x00 - protected ranges are left untouched
 
     @params[in]   SERIAL_DEBUG
                   Outputs erasing results to Serial
@@ -620,6 +1111,12 @@ byte FRAM_MB85RC_I2C::eraseDevice(void) {
 		#endif
 		
 		while((i < maxaddress) && (result == 0)){
+		  #if FRAM_PROTECT_MAX > 0
+			if ((_protCount > 0) && FRAM_MB85RC_I2C::isProtected(i, 1)) {
+				i++;
+				continue;
+			}
+		  #endif
 		  result = FRAM_MB85RC_I2C::writeByte(i, 0x00);
 		  i++;
 		}
@@ -641,87 +1138,684 @@ byte FRAM_MB85RC_I2C::eraseDevice(void) {
 		return result;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Opens a write session : WP is lowered once for the whole batch. Sessions nest,
+			only the outermost one touches the pin. See FramWriteSession for the scoped version.
 
-/*========================================================================*/
-/*                           PRIVATE FUNCTIONS                            */
-/*========================================================================*/
+	@returns
+				  0: success
+				  10: WP not managed while the chip is write protected
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::beginWrites(void) {
+	if (_wpDepth++ > 0) return ERROR_0;
+	_wpRestore = wpStatus;
+	if (wpStatus) return FRAM_MB85RC_I2C::disableWP();
+	return ERROR_0;
+}
 
 /**************************************************************************/
 /*!
-    @brief  Reads the Manufacturer ID and the Product ID from the IC and populate class' variables for devices supporting that feature
+    @brief  Closes a write session, WP is raised back if it was up when the outermost session began
 
-    @params[in]   none
-	@params[out]  manufacturerID
-                  The 12-bit manufacturer ID (Fujitsu = 0x00A)
-    @params[out]  productID
-                  The memory density (bytes 11..8) and proprietary
-                  Product ID fields (bytes 7..0). Should be 0x510 for
-                  the MB85RC256V for instance.
-	@param[out]	  The memory densitycode (bytes 11..8)
-				  from 0x03 (64K chip) to 0x07 (1M chip)
-	@param[out]	  The memory density got from density code
-				  from 64 to 1024K			  
-	@param[out]	  The memory max address of storage slot
-    @returns
-				  return code of Wire.endTransmission() or interpreted error.
+	@returns
+				  0: success
+				  10: no session open
 */
 /**************************************************************************/
-byte FRAM_MB85RC_I2C::getDeviceIDs(void)
-{
-	uint8_t localbuffer[3] = { 0, 0, 0 };
-	uint8_t result;
-	
-	/* Get device IDs sequence 	*/
-	/* 1/ Send 0xF8 to the I2C bus as a write instruction. bit 0: 0 => 0xF8 >> 1 */
-	/* Send 0xF8 to 12C bus. Bit shift to right as beginTransmission() requires a 7bit. beginTransmission() 0 for write => 0xF8 */
-	/* Send device address as 8 bits. Bit shift to left as we are using a simple write()                                        */
-	/* Send 0xF9 to I2C bus. By requesting 3 bytes to read, requestFrom() add a 1 bit at the end of a 7 bits address => 0xF9    */
-	/* See p.10 of http://www.fujitsu.com/downloads/MICRO/fsa/pdf/products/memory/fram/MB85RC-DS501-00017-3v0-E.pdf             */
-	
-	
-	Wire.beginTransmission(MASTER_CODE >> 1);
-	Wire.write((byte)(i2c_addr << 1));
-	result = Wire.endTransmission(false);
- 
-	Wire.requestFrom(MASTER_CODE >> 1, 3);
-	localbuffer[0] = (uint8_t) Wire.read();
-	localbuffer[1] = (uint8_t) Wire.read();
-	localbuffer[2] = (uint8_t) Wire.read();
-	
-	/* Shift values to separate IDs */
-	manufacturer = (localbuffer[0] << 4) + (localbuffer[1] >> 4);
-	densitycode = (uint16_t)(localbuffer[1] & 0x0F);
-	productid = ((localbuffer[1] & 0x0F) << 8) + localbuffer[2];
+byte FRAM_MB85RC_I2C::endWrites(void) {
+	if (_wpDepth == 0) return ERROR_10;
+	if (--_wpDepth > 0) return ERROR_0;
+	if (_wpRestore) return FRAM_MB85RC_I2C::enableWP();
+	return ERROR_0;
+}
 
-	if (manufacturer == FUJITSU_MANUFACT_ID) {
-			switch (densitycode) {
-				case DENSITY_MB85RC04V:
-					density = 4;
-					maxaddress = MAXADDRESS_04;
-					break;
-				case DENSITY_MB85RC64TA:
-					density = 64;
-					maxaddress = MAXADDRESS_64;
-					break;
-				case DENSITY_MB85RC256V:
-					density = 256;
-					maxaddress = MAXADDRESS_256;
-					break;
-				case DENSITY_MB85RC512T:
-					density = 512;
-					maxaddress = MAXADDRESS_512;
-					break;
-				case DENSITY_MB85RC1MT:
-					density = 1024;
-					maxaddress = MAXADDRESS_1024;
-					break;
-				default:
-					density = 0; /* means error */
-					maxaddress = 0; /* means error */
-					if (result == 0) result = ERROR_7; /*device unidentified, comminication ok*/
-					break;
-			}
-	}
+#if FRAM_PROTECT_MAX > 0
+/**************************************************************************/
+/*!
+    @brief  Marks a range read-only : writeArray() and every write built on it refuse
+			writes touching the range with ERROR_10, before any bus access
+
+    @params[in]   framAddr
+                  first address of the range
+    @params[in]   items
+                  size of the range
+	@returns
+				  0: success
+				  8: null size
+				  10: table full (FRAM_PROTECT_MAX)
+				  11: range out of the memory map
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::protectRange(uint16_t framAddr, uint16_t items) {
+	if (items == 0) return ERROR_8;
+	if (((uint32_t)framAddr + items - 1) > 0xFFFFUL) return ERROR_11;
+	if (_protCount >= FRAM_PROTECT_MAX) return ERROR_10;
+
+	_protFirst[_protCount] = framAddr;
+	_protLast[_protCount] = framAddr + (items - 1);
+	_protCount++;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Makes a protected range writable again
+
+    @params[in]   framAddr
+                  first address of the range, as given to protectRange()
+	@returns
+				  0: success
+				  10: no range starts at framAddr
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::unprotectRange(uint16_t framAddr) {
+	for (uint8_t i = 0; i < _protCount; i++) {
+		if (_protFirst[i] == framAddr) {
+			_protCount--;
+			_protFirst[i] = _protFirst[_protCount];
+			_protLast[i] = _protLast[_protCount];
+			return ERROR_0;
+		}
+	}
+	return ERROR_10;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether a range touches a protected range
+
+    @params[in]   framAddr
+                  first address of the range
+    @params[in]   items
+                  size of the range
+	@returns
+				  true if at least one byte is protected
+*/
+/**************************************************************************/
+boolean FRAM_MB85RC_I2C::isProtected(uint16_t framAddr, uint16_t items) {
+	if (items == 0) return false;
+	uint32_t last = (uint32_t)framAddr + items - 1;
+	for (uint8_t i = 0; i < _protCount; i++) {
+		if ((framAddr <= _protLast[i]) && (last >= _protFirst[i])) return true;
+	}
+	return false;
+}
+#endif
+
+#if FRAM_PIN_MAX > 0
+/**************************************************************************/
+/*!
+    @brief  Pins a range : it is mirrored in a RAM buffer provided by the caller, reads fully inside
+			the range are served from RAM, writes are written to the chip then copied to the mirror.
+			The mirror is loaded now if the chip is ready, else by begin().
+
+    @params[in]   framAddr
+                  first address of the range
+    @params[in]   items
+                  size of the range
+    @params[in]   mirror[]
+                  RAM buffer of items bytes, owned by the caller for the lifetime of the pin
+	@returns
+				  0: success
+				  10: table full (FRAM_PIN_MAX) or range overlapping a pinned one
+				  11: range out of memory map
+				  return code of Wire.endTransmission() when loading the mirror, the range is not pinned
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::pinRegion(uint16_t framAddr, uint16_t items, uint8_t mirror[]) {
+	if (items == 0) return ERROR_8;
+	if (_framInitialised && ((framAddr > maxaddress) || (((uint32_t)framAddr + items - 1) > maxaddress))) return ERROR_11;
+
+	byte result = ERROR_0;
+	uint8_t pos = 0;
+	FRAM_MB85RC_I2C::busLock(); // held until inserted : no other write between the load and the first write through
+	if (_pinCount >= FRAM_PIN_MAX) {
+		result = ERROR_10;
+	}
+	else {
+		while ((pos < _pinCount) && (_pinned[pos].framAddr < framAddr)) pos++;
+		if ((pos > 0) && (((uint32_t)_pinned[pos - 1].framAddr + _pinned[pos - 1].items) > framAddr)) result = ERROR_10;
+		if ((pos < _pinCount) && (((uint32_t)framAddr + items) > _pinned[pos].framAddr)) result = ERROR_10;
+	}
+
+	if ((result == ERROR_0) && _framInitialised) result = FRAM_MB85RC_I2C::readBlock(framAddr, items, mirror);
+
+	if (result == ERROR_0) {
+		for (uint8_t i = _pinCount; i > pos; i--) _pinned[i] = _pinned[i - 1];
+		_pinned[pos].framAddr = framAddr;
+		_pinned[pos].items = items;
+		_pinned[pos].values = mirror;
+		_pinCount++;
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Unpins the range starting at framAddr - its mirror buffer can be reused afterwards
+
+	@returns	  0: success, 10: no range starts at framAddr
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::unpinRegion(uint16_t framAddr) {
+	byte result = ERROR_10;
+	FRAM_MB85RC_I2C::busLock();
+	for (uint8_t i = 0; i < _pinCount; i++) {
+		if (_pinned[i].framAddr == framAddr) {
+			for (uint8_t j = i + 1; j < _pinCount; j++) _pinned[j - 1] = _pinned[j];
+			_pinCount--;
+			result = ERROR_0;
+			break;
+		}
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
+}
+#endif
+
+#if FRAM_DIRTY_MAX > 0
+/**************************************************************************/
+/*!
+    @brief  Number of dirty ranges - written since the last sync point
+*/
+/**************************************************************************/
+uint8_t FRAM_MB85RC_I2C::dirtyCount(void) {
+	return _dirtyCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gives one dirty range, ranges are sorted by address
+
+    @params[in]   index
+                  range index, below dirtyCount()
+    @params[out]  framAddr
+                  first address of the range
+    @params[out]  items
+                  size of the range, up to 65536 once coarsened to the whole map
+	@returns
+				  false if index is out of range
+*/
+/**************************************************************************/
+boolean FRAM_MB85RC_I2C::getDirty(uint8_t index, uint16_t *framAddr, uint32_t *items) {
+	if (index >= _dirtyCount) return false;
+	*framAddr = _dirtyFirst[index];
+	*items = (uint32_t)_dirtyLast[index] - _dirtyFirst[index] + 1;
+	return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Streams the dirty ranges and their content, then starts a new sync point.
+			Stream layout, multi-bytes fields little endian :
+			  'F' 'D' - number of ranges (1)
+			  per range : 'R' - first address (2) - last address (2) - content (last - first + 1 bytes)
+			  end : 'E' - result (1)
+			Writes done while exporting are kept for the next export. On a read error the content
+			of the failing range is completed with zeros, the stream ends there with the error
+			code as result : the receiver drops that last range. It stays dirty, with the ranges
+			not exported yet.
+
+    @params[in]   out
+                  Print object receiving the stream (Serial, a client...)
+	@returns
+				  0: success
+				  return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::exportDirty(Print &out) {
+	uint16_t first[FRAM_DIRTY_MAX];
+	uint16_t last[FRAM_DIRTY_MAX];
+
+	// snapshot - the set restarts empty, writes from now on belong to the next sync point
+	FRAM_MB85RC_I2C::busLock();
+	uint8_t count = _dirtyCount;
+	memcpy(first, _dirtyFirst, count * sizeof(uint16_t));
+	memcpy(last, _dirtyLast, count * sizeof(uint16_t));
+	FRAM_MB85RC_I2C::clearDirty();
+	FRAM_MB85RC_I2C::busUnlock();
+
+	uint8_t head[5] = { 'F', 'D', count, 0, 0 };
+	out.write(head, 3);
+
+	uint8_t buffer[FRAM_BURST_SIZE];
+	byte result = ERROR_0;
+	for (uint8_t i = 0; i < count; i++) {
+		if (result == ERROR_0) {
+			head[0] = 'R';
+			head[1] = first[i] & 0xFF;	// addresses low byte first, whatever the host
+			head[2] = first[i] >> 8;
+			head[3] = last[i] & 0xFF;
+			head[4] = last[i] >> 8;
+			out.write(head, 5);
+			uint32_t addr = first[i];
+			while (addr <= last[i]) {
+				byte n = ((last[i] - addr + 1) > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (byte)(last[i] - addr + 1);
+				if (result == ERROR_0) result = FRAM_MB85RC_I2C::readArray((uint16_t)addr, n, buffer);
+				if (result != ERROR_0) memset(buffer, 0, n);	// keeps the declared length, the range is dropped
+				out.write(buffer, n);
+				addr += n;
+			}
+		}
+		// the failing range & the ones after it stay dirty
+		if (result != ERROR_0) {
+			// in two parts : the whole map does not fit items
+			FRAM_MB85RC_I2C::busLock();
+			FRAM_MB85RC_I2C::markDirty(first[i], last[i] - first[i]);
+			FRAM_MB85RC_I2C::markDirty(last[i], 1);
+			FRAM_MB85RC_I2C::busUnlock();
+		}
+	}
+	head[0] = 'E';
+	head[1] = result;
+	out.write(head, 2);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets a sync point : forgets every dirty range
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::clearDirty(void) {
+	_dirtyCount = 0;
+	_dirtyShift = 0;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Puts the chip in sleep mode (MB85RC64TA / 512T / 1MT, Cypress FM24V & CY15B).
+			The next access wakes it up, FRAM_WAKE_US later than usual. Pinned ranges reads
+			do not access the bus and leave it asleep.
+	@returns
+				0: success, or already asleep
+				10: chip not ready, or without sleep mode
+				return code of Wire.endTransmission() on the command
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::sleep(void) {
+	if (!_framInitialised || !FRAM_MB85RC_I2C::supportsSleep()) return ERROR_10;
+
+	byte result = ERROR_0;
+	FRAM_MB85RC_I2C::busLock();
+	if (_sleepState != FRAM_SLEEP_ASLEEP) {
+		// reserved slave ID 0xF8, device address, then 0x86 after a repeated start
+		_wire->beginTransmission(MASTER_CODE >> 1);
+		_wire->write((byte)(i2c_addr << 1));
+		result = _wire->endTransmission(false);
+		if (result == ERROR_0) {
+			_wire->beginTransmission(SLEEP_MODE >> 1);
+			_wire->endTransmission(); // not acknowledged by every part, not checked
+			_sleepState = FRAM_SLEEP_ASLEEP;
+			_sleepSince = millis();
+			_sleeps++;
+		}
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Wakes the chip up ahead of a latency sensitive access - accesses wake it up anyway
+	@returns
+				0: success
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::wake(void) {
+	FRAM_MB85RC_I2C::busLock();
+	if (_sleepState == FRAM_SLEEP_ASLEEP) {
+		FRAM_MB85RC_I2C::wakeUp();
+		_sleepState = FRAM_SLEEP_BUSY;
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the idle time after which sleepPoll() puts the chip to sleep.
+			A wake-up costs FRAM_WAKE_US : keep idleMs well above the usual gaps between
+			bursts of accesses, shortSleeps() growing tells the delay is too short.
+
+    @params[in] idleMs
+                Idle time in ms, 0 turns automatic sleep off
+	@returns
+				0: success
+				10: chip not ready, or without sleep mode
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::setAutoSleep(uint32_t idleMs) {
+	if ((idleMs > 0) && (!_framInitialised || !FRAM_MB85RC_I2C::supportsSleep())) return ERROR_10;
+	_sleepIdleMs = idleMs;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Automatic sleep policy, call it from loop(). The idle time is counted from the
+			first call seeing no access since the previous one : the chip sleeps after
+			idleMs up to one loop() period later.
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::sleepPoll(void) {
+	if (_sleepIdleMs == 0) return;
+
+	FRAM_MB85RC_I2C::busLock();
+	uint32_t now = millis();
+	if (_sleepState == FRAM_SLEEP_BUSY) {
+		_sleepState = FRAM_SLEEP_IDLE;
+		_sleepSince = now;
+	}
+	else if ((_sleepState == FRAM_SLEEP_IDLE) && ((now - _sleepSince) >= _sleepIdleMs)) {
+		FRAM_MB85RC_I2C::sleep();
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether the chip is asleep
+*/
+/**************************************************************************/
+boolean FRAM_MB85RC_I2C::isAsleep(void) {
+	return _sleepState == FRAM_SLEEP_ASLEEP;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of times the chip was put to sleep
+*/
+/**************************************************************************/
+uint32_t FRAM_MB85RC_I2C::sleepCount(void) {
+	return _sleeps;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of sleeps ended by an access before lasting the automatic sleep idle time
+*/
+/**************************************************************************/
+uint32_t FRAM_MB85RC_I2C::shortSleeps(void) {
+	return _shortSleeps;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Time spent asleep in ms, current sleep included
+*/
+/**************************************************************************/
+uint32_t FRAM_MB85RC_I2C::asleepMs(void) {
+	if (_sleepState == FRAM_SLEEP_ASLEEP) return _asleepMs + (millis() - _sleepSince);
+	return _asleepMs;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Time spent waking the chip up in us, added to the accesses that woke it up
+*/
+/**************************************************************************/
+uint32_t FRAM_MB85RC_I2C::wakePenaltyUs(void) {
+	return _wakeUs;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Resets the sleep statistics
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::clearSleepStats(void) {
+	_sleeps = 0;
+	_shortSleeps = 0;
+	_asleepMs = 0;
+	_wakeUs = 0;
+	if (_sleepState == FRAM_SLEEP_ASLEEP) _sleepSince = millis();
+}
+
+#if FRAM_TRACE_DEPTH > 0
+/**************************************************************************/
+/*!
+    @brief  Clears the trace and starts recording every transfer
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::traceStart(void) {
+	FRAM_MB85RC_I2C::busLock();
+	_traceHead = 0;
+	_traceCount = 0;
+	_traceLost = 0;
+	_tracing = true;
+	FRAM_MB85RC_I2C::busUnlock();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stops recording, the records are kept until the next traceStart()
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::traceStop(void) {
+	_tracing = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of records held, up to FRAM_TRACE_DEPTH
+*/
+/**************************************************************************/
+uint16_t FRAM_MB85RC_I2C::traceCount(void) {
+	return _traceCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gives one record, oldest first
+
+    @params[in]   index
+                  record index, below traceCount()
+    @params[out]  record
+                  copy of the record
+	@returns
+				  false if index is out of range
+*/
+/**************************************************************************/
+boolean FRAM_MB85RC_I2C::getTrace(uint16_t index, FramTraceRecord *record) {
+	if (index >= _traceCount) return false;
+	*record = _trace[(_traceHead + index) % FRAM_TRACE_DEPTH];
+	return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prints the trace as CSV, oldest first, for extras/trace_replay.py.
+			Recording is paused while printing, Serial transfers of the export are not traced.
+			Output :
+			  # FRAM trace, density_kbit,lost
+			  op,addr,len,us
+			  W,256,16,1234567
+			  ...
+
+    @params[in]   out
+                  Print object receiving the trace (Serial...)
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::exportTrace(Print &out) {
+	boolean tracing = _tracing;
+	_tracing = false;
+
+	out.print("# FRAM trace,");
+	out.print(density, DEC);
+	out.print(",");
+	out.println(_traceLost, DEC);
+	out.println("op,addr,len,us");
+	FramTraceRecord record;
+	for (uint16_t i = 0; FRAM_MB85RC_I2C::getTrace(i, &record); i++) {
+		out.print((char)record.op);
+		out.print(",");
+		out.print(record.framAddr, DEC);
+		out.print(",");
+		out.print(record.items, DEC);
+		out.print(",");
+		out.println(record.time, DEC);
+	}
+	_tracing = tracing;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  CRC-16/CCITT (poly 0x1021) used by the integrity checked structures.
+			Can be chained over several buffers by passing the previous result.
+
+    @params[in]   crc
+                  initial value (0xFFFF) or CRC of the previous buffers
+    @params[in]   data[]
+                  bytes to add to the CRC
+    @params[in]   len
+                  number of bytes
+	@returns	  updated CRC
+*/
+/**************************************************************************/
+uint16_t FRAM_MB85RC_I2C::crc16(uint16_t crc, const uint8_t data[], uint16_t len) {
+	for (uint16_t i = 0; i < len; i++) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (byte b = 0; b < 8; b++) {
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+#if FRAM_THREAD_SAFE
+/**************************************************************************/
+/*!
+    @brief  Plugs the lock used to serialize bus transactions of the instances on a same bus.
+			The functions get the bus of the instance : one lock per bus lets transfers on two
+			controllers run concurrently from two tasks.
+			The lock must be recursive: bit operations & copyByte() hold it around nested transactions.
+			On ESP32 a FreeRTOS recursive mutex per bus is used unless another lock is plugged.
+			Plug it before the tasks sharing the bus are started.
+
+    @params[in]   lockFn
+                  function blocking until the bus given is owned by the caller
+    @params[in]   unlockFn
+                  function releasing the bus given
+	@returns	  void
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::setBusLock(void (*lockFn)(TwoWire *wire), void (*unlockFn)(TwoWire *wire)) {
+	framBusLockFn = lockFn;
+	framBusUnlockFn = unlockFn;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Takes the lock of the bus of this instance. Also usable by the application to make a sequence of calls atomic
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::busLock(void) {
+	if (framBusLockFn != NULL) framBusLockFn(_wire);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Releases the lock of the bus of this instance
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::busUnlock(void) {
+	if (framBusUnlockFn != NULL) framBusUnlockFn(_wire);
+}
+#endif
+
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Reads the Manufacturer ID and the Product ID from the IC and populate class' variables for devices supporting that feature
+
+    @params[in]   none
+	@params[out]  manufacturerID
+                  The 12-bit manufacturer ID (Fujitsu = 0x00A)
+    @params[out]  productID
+                  The memory density (bytes 11..8) and proprietary
+                  Product ID fields (bytes 7..0). Should be 0x510 for
+                  the MB85RC256V for instance.
+	@param[out]	  The memory densitycode (bytes 11..8)
+				  from 0x03 (64K chip) to 0x07 (1M chip)
+	@param[out]	  The memory density got from density code
+				  from 64 to 1024K			  
+	@param[out]	  The memory max address of storage slot
+    @returns
+				  return code of Wire.endTransmission() or interpreted error.
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::getDeviceIDs(void)
+{
+	uint8_t localbuffer[3] = { 0, 0, 0 };
+	uint8_t result;
+	
+	/* Get device IDs sequence 	*/
+	/* 1/ Send 0xF8 to the I2C bus as a write instruction. bit 0: 0 => 0xF8 >> 1 */
+	/* Send 0xF8 to 12C bus. Bit shift to right as beginTransmission() requires a 7bit. beginTransmission() 0 for write => 0xF8 */
+	/* Send device address as 8 bits. Bit shift to left as we are using a simple write()                                        */
+	/* Send 0xF9 to I2C bus. By requesting 3 bytes to read, requestFrom() add a 1 bit at the end of a 7 bits address => 0xF9    */
+	/* See p.10 of http://www.fujitsu.com/downloads/MICRO/fsa/pdf/products/memory/fram/MB85RC-DS501-00017-3v0-E.pdf             */
+	
+	
+	FRAM_MB85RC_I2C::busLock();
+	if (_sleepState != FRAM_SLEEP_BUSY) {
+		if (_sleepState == FRAM_SLEEP_ASLEEP) FRAM_MB85RC_I2C::wakeUp();
+		_sleepState = FRAM_SLEEP_BUSY;
+	}
+	_wire->beginTransmission(MASTER_CODE >> 1);
+	_wire->write((byte)(i2c_addr << 1));
+	result = _wire->endTransmission(false);
+ 
+	_wire->requestFrom(MASTER_CODE >> 1, 3);
+	localbuffer[0] = (uint8_t) _wire->read();
+	localbuffer[1] = (uint8_t) _wire->read();
+	localbuffer[2] = (uint8_t) _wire->read();
+	FRAM_MB85RC_I2C::busUnlock();
+	
+	/* Shift values to separate IDs */
+	manufacturer = (localbuffer[0] << 4) + (localbuffer[1] >> 4);
+	densitycode = (uint16_t)(localbuffer[1] & 0x0F);
+	productid = ((localbuffer[1] & 0x0F) << 8) + localbuffer[2];
+
+	if (manufacturer == FUJITSU_MANUFACT_ID) {
+			switch (densitycode) {
+				case DENSITY_MB85RC04V:
+					density = 4;
+					maxaddress = MAXADDRESS_04;
+					break;
+				case DENSITY_MB85RC64TA:
+					density = 64;
+					maxaddress = MAXADDRESS_64;
+					break;
+				case DENSITY_MB85RC256V:
+					density = 256;
+					maxaddress = MAXADDRESS_256;
+					break;
+				case DENSITY_MB85RC512T:
+					density = 512;
+					maxaddress = MAXADDRESS_512;
+					break;
+				case DENSITY_MB85RC1MT:
+					density = 1024;
+					maxaddress = MAXADDRESS_1024;
+					break;
+				default:
+					density = 0; /* means error */
+					maxaddress = 0; /* means error */
+					if (result == 0) result = ERROR_7; /*device unidentified, comminication ok*/
+					break;
+			}
+	}
 	else if (manufacturer == CYPRESS_MANUFACT_ID) {
 			switch (densitycode) {
 				case DENSITY_CY15B128J:
@@ -876,6 +1970,335 @@ byte FRAM_MB85RC_I2C::initWP(boolean wp) {
 	return result;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Resets the optional features state, shared by all constructors
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::initFeatures(void) {
+	_wire = &Wire;
+	#if FRAM_DIRTY_MAX > 0
+		_dirtyCount = 0;
+		_dirtyShift = 0;
+	#endif
+	#if FRAM_TRACE_DEPTH > 0
+		_traceHead = 0;
+		_traceCount = 0;
+		_traceLost = 0;
+		_tracing = false;
+	#endif
+	_wpDepth = 0;
+	_wpRestore = false;
+	_sleepState = FRAM_SLEEP_BUSY;
+	_sleepIdleMs = 0;
+	_sleepSince = 0;
+	FRAM_MB85RC_I2C::clearSleepStats();
+	#if FRAM_PROTECT_MAX > 0
+		_protCount = 0;
+	#endif
+	#if FRAM_PIN_MAX > 0
+		_pinCount = 0;
+	#endif
+}
+
+#if FRAM_PIN_MAX > 0
+/**************************************************************************/
+/*!
+    @brief  Loads every pinned range from the chip into its mirror - called by begin().
+			A range failing to load is unpinned, the others are still loaded.
+
+	@returns	  0: success, else the return code of the first range failing to load
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::loadPinned(void) {
+	byte result = ERROR_0;
+	FRAM_MB85RC_I2C::busLock();
+	uint8_t count = _pinCount;
+	uint8_t kept = 0;
+	_pinCount = 0; // read from the chip, not from the mirrors being loaded
+	for (uint8_t i = 0; i < count; i++) {
+		byte loaded = FRAM_MB85RC_I2C::readBlock(_pinned[i].framAddr, _pinned[i].items, _pinned[i].values);
+		if (loaded == ERROR_0) {
+			_pinned[kept++] = _pinned[i];
+		}
+		else if (result == ERROR_0) {
+			result = loaded;
+		}
+	}
+	_pinCount = kept;
+	FRAM_MB85RC_I2C::busUnlock();
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Serves a read from a mirror when the range is fully inside a pinned range (binary search).
+			Under the bus lock : the table does not change meanwhile, the trace keeps the order of the transfers.
+
+	@returns	  true if served, false if the chip must be read
+*/
+/**************************************************************************/
+boolean FRAM_MB85RC_I2C::readPinned(uint16_t framAddr, byte items, uint8_t values[]) {
+	FRAM_MB85RC_I2C::busLock();
+	uint8_t lo = 0;
+	uint8_t hi = _pinCount;
+	while (lo < hi) {
+		uint8_t mid = (lo + hi) / 2;
+		if (_pinned[mid].framAddr <= framAddr) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	boolean served = false;
+	if (lo > 0) {
+		FramIOVec *region = &_pinned[lo - 1];
+		if (((uint32_t)framAddr + items) <= ((uint32_t)region->framAddr + region->items)) {
+			memcpy(values, &region->values[framAddr - region->framAddr], items);
+			#if FRAM_TRACE_DEPTH > 0
+				FRAM_MB85RC_I2C::traceRecord(FRAM_TRACE_PINNED, framAddr, items);
+			#endif
+			served = true;
+		}
+	}
+	FRAM_MB85RC_I2C::busUnlock();
+	return served;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a successful write to the mirrors it overlaps
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::writePinned(uint16_t framAddr, byte items, uint8_t values[]) {
+	uint32_t end = (uint32_t)framAddr + items;
+	for (uint8_t i = 0; i < _pinCount; i++) {
+		FramIOVec *region = &_pinned[i];
+		uint32_t regionEnd = (uint32_t)region->framAddr + region->items;
+		if (region->framAddr >= end) break;
+		if (regionEnd <= framAddr) continue;
+
+		uint32_t lo = (region->framAddr > framAddr) ? region->framAddr : framAddr;
+		uint32_t hi = (regionEnd < end) ? regionEnd : end;
+		memcpy(&region->values[lo - region->framAddr], &values[lo - framAddr], hi - lo);
+	}
+}
+#endif
+
+#if FRAM_DIRTY_MAX > 0
+/**************************************************************************/
+/*!
+    @brief  Adds a written range to the dirty set, merged with the ranges it overlaps or touches.
+			When the table is full the granularity doubles until the range fits.
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::markDirty(uint16_t framAddr, uint16_t items) {
+	if (items == 0) return;
+	while (true) {
+		uint32_t mask = (1UL << _dirtyShift) - 1;
+		uint32_t first = framAddr & ~mask;
+		uint32_t last = ((uint32_t)framAddr + items - 1) | mask;
+		if (last > 0xFFFF) last = 0xFFFF;
+
+		uint8_t lo = 0;
+		while ((lo < _dirtyCount) && (((uint32_t)_dirtyLast[lo] + 1) < first)) lo++;
+		uint8_t hi = lo;
+		while ((hi < _dirtyCount) && (_dirtyFirst[hi] <= (last + 1))) {
+			if (_dirtyFirst[hi] < first) first = _dirtyFirst[hi];
+			if (_dirtyLast[hi] > last) last = _dirtyLast[hi];
+			hi++;
+		}
+
+		if ((hi > lo) || (_dirtyCount < FRAM_DIRTY_MAX)) {
+			if (hi == lo) {
+				// new range, make room at lo
+				for (uint8_t i = _dirtyCount; i > lo; i--) {
+					_dirtyFirst[i] = _dirtyFirst[i - 1];
+					_dirtyLast[i] = _dirtyLast[i - 1];
+				}
+				_dirtyCount++;
+				hi = lo + 1;
+			}
+			_dirtyFirst[lo] = (uint16_t)first;
+			_dirtyLast[lo] = (uint16_t)last;
+			// ranges [lo + 1, hi) were absorbed
+			uint8_t gone = hi - lo - 1;
+			for (uint8_t i = hi; i < _dirtyCount; i++) {
+				_dirtyFirst[i - gone] = _dirtyFirst[i];
+				_dirtyLast[i - gone] = _dirtyLast[i];
+			}
+			_dirtyCount -= gone;
+			return;
+		}
+		FRAM_MB85RC_I2C::coarsenDirty();
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Doubles the dirty ranges granularity and merges the ranges now touching
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::coarsenDirty(void) {
+	_dirtyShift++;
+	uint32_t mask = (1UL << _dirtyShift) - 1;
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < _dirtyCount; i++) {
+		uint32_t first = _dirtyFirst[i] & ~mask;
+		uint32_t last = _dirtyLast[i] | mask;
+		if (last > 0xFFFF) last = 0xFFFF;
+		if ((n > 0) && (first <= ((uint32_t)_dirtyLast[n - 1] + 1))) {
+			if (last > _dirtyLast[n - 1]) _dirtyLast[n - 1] = (uint16_t)last;
+		}
+		else {
+			_dirtyFirst[n] = (uint16_t)first;
+			_dirtyLast[n] = (uint16_t)last;
+			n++;
+		}
+	}
+	_dirtyCount = n;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Writes count values of size bytes with their byte order swapped, through a burst buffer
+			holding whole values. The whole range is checked before the first byte is written.
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::writeSwapped(uint16_t framAddr, uint16_t count, uint8_t size, const uint8_t values[])
+{
+	uint16_t items = count * size;
+	if (items == 0) return ERROR_0;
+	if ((framAddr > maxaddress) || (((uint32_t)framAddr + items - 1) > maxaddress)) return ERROR_11;
+	#if FRAM_PROTECT_MAX > 0
+		if ((_protCount > 0) && FRAM_MB85RC_I2C::isProtected(framAddr, items)) return ERROR_10;
+	#endif
+
+	uint32_t buffer[FRAM_BURST_SIZE / 4];	// aligned for the kernels
+	const uint16_t perBurst = sizeof(buffer) / size;
+	byte result = ERROR_0;
+	uint16_t done = 0;
+	while ((done < count) && (result == ERROR_0)) {
+		uint16_t n = ((count - done) > perBurst) ? perBurst : (count - done);
+		memcpy(buffer, &values[done * size], n * size);
+		if (size == 2) framSwapWords(reinterpret_cast<uint16_t *>(buffer), n);
+		else framSwapLongs(buffer, n);
+		result = FRAM_MB85RC_I2C::writeArray(framAddr + done * size, (byte)(n * size), reinterpret_cast<uint8_t *>(buffer));
+		done += n;
+	}
+	return result;
+}
+
+#if FRAM_TRACE_DEPTH > 0
+/**************************************************************************/
+/*!
+    @brief  Appends a record to the trace ring, the oldest one is dropped when full
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::traceRecord(uint8_t op, uint16_t framAddr, uint8_t items) {
+	if (!_tracing) return;
+
+	FramTraceRecord *record;
+	if (_traceCount < FRAM_TRACE_DEPTH) {
+		record = &_trace[(_traceHead + _traceCount) % FRAM_TRACE_DEPTH];
+		_traceCount++;
+	}
+	else {
+		record = &_trace[_traceHead];
+		_traceHead = (_traceHead + 1) % FRAM_TRACE_DEPTH;
+		_traceLost++;
+	}
+	record->time = micros();
+	record->framAddr = framAddr;
+	record->items = items;
+	record->op = op;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Reads from the chip's current address latch (last address accessed + 1), no address phase.
+			Only valid while the bus lock is held right after another access of this chip.
+
+    @params[in]  items : number of bytes
+	@param[out]	 values[] : bytes read
+	@returns	 0: success, 2: less bytes received than requested
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::readCurrent(byte items, uint8_t values[]) {
+	byte received = _wire->requestFrom(i2c_addr, (uint8_t)items);
+	for (byte i=0; i < items; i++) {
+		values[i] = _wire->read();
+	}
+	return (received == items) ? ERROR_0 : ERROR_2;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks the entries of readv() / writev() and sorts their indexes by address (insertion sort, stable)
+
+	@param[out]	 order[] : entries indexes sorted by address
+	@returns	 0: success, 8: null length entry, 10: too many entries, 11: entry out of memory map
+*/
+/**************************************************************************/
+byte FRAM_MB85RC_I2C::sortIOVec(FramIOVec vec[], uint8_t count, uint8_t order[]) {
+	if (count > FRAM_IOV_MAX) return ERROR_10;
+
+	for (uint8_t i = 0; i < count; i++) {
+		if (vec[i].items == 0) return ERROR_8;
+		if ((vec[i].framAddr > maxaddress) || (((uint32_t)vec[i].framAddr + vec[i].items - 1) > maxaddress)) return ERROR_11;
+
+		uint8_t j = i;
+		while ((j > 0) && (vec[order[j - 1]].framAddr > vec[i].framAddr)) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether the chip has a sleep mode - manual mode trusts the caller for 64K and more
+*/
+/**************************************************************************/
+boolean FRAM_MB85RC_I2C::supportsSleep(void) {
+	switch (manufacturer) {
+		case CYPRESS_MANUFACT_ID:
+			return true;
+		case FUJITSU_MANUFACT_ID:
+			return (densitycode == DENSITY_MB85RC64TA) || (densitycode == DENSITY_MB85RC512T) || (densitycode == DENSITY_MB85RC1MT);
+		case MANUALMODE_MANUFACT_ID:
+			return density >= 64;
+		default:
+			return false;
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Wake-up sequence : the device address, most likely not acknowledged, then tREC.
+			Called with the bus locked, the caller sets the new state.
+*/
+/**************************************************************************/
+void FRAM_MB85RC_I2C::wakeUp(void) {
+	uint32_t start = micros();
+	_wire->beginTransmission(i2c_addr);
+	_wire->endTransmission();
+	delayMicroseconds(FRAM_WAKE_US);
+	_wakeUs += micros() - start;
+
+	if (_sleepState == FRAM_SLEEP_ASLEEP) {
+		uint32_t slept = millis() - _sleepSince;
+		_asleepMs += slept;
+		if ((_sleepIdleMs > 0) && (slept < _sleepIdleMs)) _shortSleeps++;
+	}
+}
+
 /**************************************************************************/
 /*!
     @brief 	Adapts the I2C calls (chip address + memory pointer) according to chip datasheet
@@ -892,6 +2315,12 @@ byte FRAM_MB85RC_I2C::initWP(boolean wp) {
 void FRAM_MB85RC_I2C::I2CAddressAdapt(uint16_t framAddr) {
 	
 	uint8_t chipaddress;
+
+	// every transfer addressing the memory goes through here : the only cost of idle tracking
+	if (_sleepState != FRAM_SLEEP_BUSY) {
+		if (_sleepState == FRAM_SLEEP_ASLEEP) FRAM_MB85RC_I2C::wakeUp();
+		_sleepState = FRAM_SLEEP_BUSY;
+	}
 	
 	switch(density) {
 		case 4:
@@ -913,13 +2342,13 @@ void FRAM_MB85RC_I2C::I2CAddressAdapt(uint16_t framAddr) {
 	#endif
 	
 	if (density < 64) {
-		Wire.beginTransmission(i2c_addr);
-		Wire.write(framAddr & 0xFF);
+		_wire->beginTransmission(i2c_addr);
+		_wire->write(framAddr & 0xFF);
 	}
 	else {
-		Wire.beginTransmission(i2c_addr);
-		Wire.write(framAddr >> 8);
-		Wire.write(framAddr & 0xFF);	
+		_wire->beginTransmission(i2c_addr);
+		_wire->write(framAddr >> 8);
+		_wire->write(framAddr & 0xFF);	
 	}
 	return;
 }
@@ -95,6 +95,19 @@
 #define MAXADDRESS_512 65535
 #define MAXADDRESS_1024 65535 // 1M devices are in fact managed as 2 512 devices from lib point of view > create 2 instances of the object with each a differnt address
 
+// Largest payload moved in one I2C transaction - bounded by the Wire lib buffer, minus the 2 memory address bytes
+#if defined(I2C_BUFFER_LENGTH)
+ #define FRAM_BURST_SIZE (I2C_BUFFER_LENGTH - 2)
+#elif defined(BUFFER_LENGTH)
+ #define FRAM_BURST_SIZE (BUFFER_LENGTH - 2)
+#else
+ #define FRAM_BURST_SIZE 30
+#endif
+#if FRAM_BURST_SIZE > 255
+ #undef FRAM_BURST_SIZE
+ #define FRAM_BURST_SIZE 255 // readArray() & writeArray() item count is a byte
+#endif
+
 // Adresses
 #define MB85RC_ADDRESS_A000   0x50
 #define MB85RC_ADDRESS_A001   0x51
@@ -108,7 +121,7 @@
 
 //Special commands
 #define MASTER_CODE	0xF8
-#define SLEEP_MODE	0x86 //Cypress codes, not used here	
+#define SLEEP_MODE	0x86 //Cypress & Fujitsu sleep command, see sleep()
 #define HIGH_SPEED	0x08 //Cypress codes, not used here
 
 // Managing Write protect pin
@@ -116,6 +129,64 @@
 #define DEFAULT_WP_PIN	13 //write protection pin - active high, write enabled when low
 #define DEFAULT_WP_STATUS  false //false means protection is off - write is enabled
 
+// Shared bus locking for RTOS tasks - 1 to serialize bus transactions of the instances on a same bus, 0 compiles locking away
+// One FreeRTOS recursive mutex per bus used by default on ESP32, any other RTOS can be plugged with setBusLock()
+#ifndef FRAM_THREAD_SAFE
+ #if defined(ESP32) || defined(ESP_PLATFORM)
+  #define FRAM_THREAD_SAFE 1
+ #else
+  #define FRAM_THREAD_SAFE 0
+ #endif
+#endif
+// Buses with their own default mutex (ESP32), further buses share the mutex of the first one
+#ifndef FRAM_BUS_MAX
+#define FRAM_BUS_MAX 2
+#endif
+
+// Scatter / gather - maximum entries per readv() / writev() call & default gap (bytes of filler read rather than a new address phase)
+#ifndef FRAM_IOV_MAX
+#define FRAM_IOV_MAX 32
+#endif
+#ifndef FRAM_IOV_GAP
+#define FRAM_IOV_GAP 4
+#endif
+
+// Pinned regions - ranges mirrored in RAM : reads served from RAM, writes written through (e.g. 4). 0 compiles the feature away
+#ifndef FRAM_PIN_MAX
+#define FRAM_PIN_MAX 0
+#endif
+
+// Dirty ranges tracking - ranges written since the last sync point, coarsened when the table is full (e.g. 8). 0 compiles the feature away
+#ifndef FRAM_DIRTY_MAX
+#define FRAM_DIRTY_MAX 0
+#endif
+
+// Software protection map - read-only ranges refused by the write path without bus access (e.g. 4). 0 compiles the feature away
+#ifndef FRAM_PROTECT_MAX
+#define FRAM_PROTECT_MAX 0
+#endif
+
+// Access trace - the last FRAM_TRACE_DEPTH transfers recorded in RAM (8 bytes each), see extras/host/trace_replay.cpp. 0 compiles the feature away
+#ifndef FRAM_TRACE_DEPTH
+#define FRAM_TRACE_DEPTH 0
+#endif
+#define FRAM_TRACE_READ 'R'		// read with address phase
+#define FRAM_TRACE_LATCH 'L'	// read from the chip's address latch, no address phase
+#define FRAM_TRACE_PINNED 'P'	// read served from a pinned range, no bus traffic
+#define FRAM_TRACE_WRITE 'W'
+
+// Sleep mode - recovery time after the wake-up address byte (tREC, 400us max on MB85RC1MT & FM24V10)
+#ifndef FRAM_WAKE_US
+#define FRAM_WAKE_US 400
+#endif
+#define FRAM_SLEEP_BUSY 0	// bus accessed since the last sleepPoll()
+#define FRAM_SLEEP_IDLE 1	// no access since _sleepSince
+#define FRAM_SLEEP_ASLEEP 2
+
+// Byte order of 16 / 32-bit arrays in FRAM (readWords() & co) - readWord() & co always store the host order, little endian on Arduino targets
+#define FRAM_LITTLE_ENDIAN 0
+#define FRAM_BIG_ENDIAN 1
+
 // Error management
 #define ERROR_0 0 // Success    
 #define ERROR_1 1 // Data too long to fit the transmission buffer on Arduino
@@ -129,6 +200,22 @@
 #define ERROR_9 9 // Bit position out of range
 #define ERROR_10 10 // Not permitted opération
 #define ERROR_11 11 // Memory address out of range
+#define ERROR_12 12 // Data integrity check failed
+#define ERROR_13 13 // Time budget too short for any progress
+
+
+typedef struct {
+	uint16_t	framAddr;
+	uint16_t	items;
+	uint8_t		*values;
+} FramIOVec;
+
+typedef struct {
+	uint32_t	time;		// micros() at the start of the transfer
+	uint16_t	framAddr;
+	uint8_t		items;
+	uint8_t		op;			// FRAM_TRACE_xxx
+} FramTraceRecord;
 
 
 class FRAM_MB85RC_I2C {
@@ -138,7 +225,9 @@ class FRAM_MB85RC_I2C {
 	FRAM_MB85RC_I2C(uint8_t address, boolean wp, int pin);
 	FRAM_MB85RC_I2C(uint8_t address, boolean wp, int pin, uint16_t chipDensity);
 	
-	void	begin(void);
+	void	setWire(TwoWire *wire);
+	TwoWire	*getWire(void);
+	byte	begin(void);
 	byte	checkDevice(void);
 	byte	readBit(uint16_t framAddr, uint8_t bitNb, byte *bit);
 	byte	setOneBit(uint16_t framAddr, uint8_t bitNb);
@@ -146,6 +235,10 @@ class FRAM_MB85RC_I2C {
 	byte	toggleBit(uint16_t framAddr, uint8_t bitNb);
 	byte	readArray (uint16_t framAddr, byte items, uint8_t value[]);
 	byte	writeArray (uint16_t framAddr, byte items, uint8_t value[]);
+	byte	readBlock (uint16_t framAddr, uint16_t items, uint8_t value[]);
+	byte	writeBlock (uint16_t framAddr, uint16_t items, uint8_t value[]);
+	byte	readv (FramIOVec vec[], uint8_t count, uint16_t gap = FRAM_IOV_GAP);
+	byte	writev (FramIOVec vec[], uint8_t count);
 	byte	readByte (uint16_t framAddr, uint8_t *value);
 	byte	writeByte (uint16_t framAddr, uint8_t value);
 	byte	copyByte (uint16_t origAddr, uint16_t destAddr);
@@ -153,15 +246,69 @@ class FRAM_MB85RC_I2C {
 	byte	writeWord(uint16_t framAddr, uint16_t value);
 	byte	readLong(uint16_t framAddr, uint32_t *value);
 	byte	writeLong(uint16_t framAddr, uint32_t value);
+	byte	readWords(uint16_t framAddr, uint16_t count, uint16_t values[], uint8_t order = FRAM_LITTLE_ENDIAN);
+	byte	writeWords(uint16_t framAddr, uint16_t count, uint16_t values[], uint8_t order = FRAM_LITTLE_ENDIAN);
+	byte	readLongs(uint16_t framAddr, uint16_t count, uint32_t values[], uint8_t order = FRAM_LITTLE_ENDIAN);
+	byte	writeLongs(uint16_t framAddr, uint16_t count, uint32_t values[], uint8_t order = FRAM_LITTLE_ENDIAN);
 	byte	getOneDeviceID(uint8_t idType, uint16_t *id);
 	boolean	isReady(void);
 	boolean	getWPStatus(void);
 	byte	enableWP(void);
 	byte	disableWP(void);
 	byte	eraseDevice(void);
+	byte	beginWrites(void);
+	byte	endWrites(void);
+	byte	sleep(void);
+	byte	wake(void);
+	byte	setAutoSleep(uint32_t idleMs);
+	void	sleepPoll(void);
+	boolean	isAsleep(void);
+	uint32_t	sleepCount(void);
+	uint32_t	shortSleeps(void);
+	uint32_t	asleepMs(void);
+	uint32_t	wakePenaltyUs(void);
+	void	clearSleepStats(void);
+
+#if FRAM_PROTECT_MAX > 0
+	byte	protectRange(uint16_t framAddr, uint16_t items);
+	byte	unprotectRange(uint16_t framAddr);
+	boolean	isProtected(uint16_t framAddr, uint16_t items);
+#endif
+
+#if FRAM_PIN_MAX > 0
+	byte	pinRegion(uint16_t framAddr, uint16_t items, uint8_t mirror[]);
+	byte	unpinRegion(uint16_t framAddr);
+#endif
+
+#if FRAM_DIRTY_MAX > 0
+	uint8_t	dirtyCount(void);
+	boolean	getDirty(uint8_t index, uint16_t *framAddr, uint32_t *items);
+	byte	exportDirty(Print &out);
+	void	clearDirty(void);
+#endif
+
+#if FRAM_TRACE_DEPTH > 0
+	void	traceStart(void);
+	void	traceStop(void);
+	uint16_t	traceCount(void);
+	boolean	getTrace(uint16_t index, FramTraceRecord *record);
+	void	exportTrace(Print &out);
+#endif
+
+	static uint16_t	crc16(uint16_t crc, const uint8_t data[], uint16_t len);
+
+#if FRAM_THREAD_SAFE
+	static void	setBusLock(void (*lockFn)(TwoWire *wire), void (*unlockFn)(TwoWire *wire));
+	void	busLock(void);
+	void	busUnlock(void);
+#else
+	void	busLock(void) {}
+	void	busUnlock(void) {}
+#endif
   
  private:
 	uint8_t	i2c_addr;
+	TwoWire	*_wire;
 	boolean	_framInitialised;
 	boolean	_manualMode;
 	uint16_t	manufacturer;
@@ -172,12 +319,90 @@ class FRAM_MB85RC_I2C {
 
 	int	wpPin;
 	boolean	wpStatus;
+	uint8_t	_wpDepth;	// nested write sessions
+	boolean	_wpRestore;	// WP to raise again when the outer session ends
+
+	uint8_t	_sleepState;	// FRAM_SLEEP_xxx
+	uint32_t	_sleepIdleMs;	// auto sleep delay, 0 when off
+	uint32_t	_sleepSince;	// millis() at the start of the idle period, or of the sleep
+	uint32_t	_sleeps;
+	uint32_t	_shortSleeps;	// sleeps ended before lasting _sleepIdleMs
+	uint32_t	_asleepMs;		// completed sleeps only
+	uint32_t	_wakeUs;
+
+#if FRAM_PROTECT_MAX > 0
+	uint16_t	_protFirst[FRAM_PROTECT_MAX];
+	uint16_t	_protLast[FRAM_PROTECT_MAX];	// inclusive, the last byte of the map can be protected
+	uint8_t	_protCount;
+#endif
+
+#if FRAM_PIN_MAX > 0
+	FramIOVec	_pinned[FRAM_PIN_MAX];	// sorted by address
+	uint8_t	_pinCount;
+	byte	loadPinned(void);
+	boolean	readPinned(uint16_t framAddr, byte items, uint8_t values[]);
+	void	writePinned(uint16_t framAddr, byte items, uint8_t values[]);
+#endif
+
+#if FRAM_DIRTY_MAX > 0
+	uint16_t	_dirtyFirst[FRAM_DIRTY_MAX];	// sorted, disjoint & not adjacent
+	uint16_t	_dirtyLast[FRAM_DIRTY_MAX];		// inclusive
+	uint8_t	_dirtyCount;
+	uint8_t	_dirtyShift;	// granularity : ranges rounded to 2^_dirtyShift bytes blocks
+	void	markDirty(uint16_t framAddr, uint16_t items);
+	void	coarsenDirty(void);
+#endif
+
+#if FRAM_TRACE_DEPTH > 0
+	FramTraceRecord	_trace[FRAM_TRACE_DEPTH];	// ring, oldest at _traceHead once full
+	uint16_t	_traceHead;
+	uint16_t	_traceCount;
+	uint32_t	_traceLost;
+	boolean	_tracing;
+	void	traceRecord(uint8_t op, uint16_t framAddr, uint8_t items);
+#endif
 
 	byte	getDeviceIDs(void);	
 	byte	setDeviceIDs(void);
 	byte	initWP(boolean wp);
 	byte	deviceIDs2Serial(void);
+	void	initFeatures(void);
+#if FRAM_PIN_MAX > 0
+	boolean	hasPinned(void) { return _pinCount > 0; }
+#else
+	boolean	hasPinned(void) { return false; }
+#endif
+	boolean	supportsSleep(void);
+	void	wakeUp(void);
 	void	I2CAddressAdapt(uint16_t framAddr);
+	byte	readCurrent(byte items, uint8_t values[]);
+	byte	sortIOVec(FramIOVec vec[], uint8_t count, uint8_t order[]);
+	byte	writeSwapped(uint16_t framAddr, uint16_t count, uint8_t size, const uint8_t values[]);
+};
+
+/**************************************************************************/
+/*!
+    Write session : lowers WP once for a batch of writes, raises it back when
+    the outermost session goes out of scope. Nested sessions are free.
+
+      {
+        FramWriteSession session(&mymemory);
+        mymemory.writeLong(0x100, a);
+        mymemory.writeLong(0x104, b);
+      } // WP restored here
+*/
+/**************************************************************************/
+class FramWriteSession {
+ public:
+	FramWriteSession(FRAM_MB85RC_I2C *fram) : _fram(fram) { _result = _fram->beginWrites(); }
+	~FramWriteSession() { _fram->endWrites(); }
+	byte	status(void) { return _result; }
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	byte	_result;
+	FramWriteSession(const FramWriteSession &);
+	FramWriteSession &operator=(const FramWriteSession &);
 };
 
 #endif
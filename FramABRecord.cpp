@@ -0,0 +1,177 @@
+/**************************************************************************/
+/*!
+    @file     FramABRecord.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    A/B double buffered record on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramABRecord.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the record lives on
+    @params[in] baseAddr
+                First address of the record region
+    @params[in] recordSize
+                Maximum size of the record, the region uses footprint() bytes
+*/
+/**************************************************************************/
+FramABRecord::FramABRecord(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t recordSize)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_size = recordSize;
+	_generation = 0;
+	_active = FRAM_AB_NO_SLOT;
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Loads the newest valid copy. Both headers are read in one transaction,
+			then only the newest slot is read - the older one is read only if the newest fails its CRC.
+
+    @params[out] data[]
+                Buffer of recordSize bytes receiving the record
+    @params[out] length
+                Length of the record loaded
+    @returns
+				0: success
+				12: no valid copy (blank region or both copies corrupted)
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramABRecord::begin(uint8_t data[], uint16_t *length)
+{
+	FramABHeader headers[2];
+	byte result = _fram->readArray(_base, 2 * FRAM_AB_HEADER_SIZE, reinterpret_cast<uint8_t *>(headers));
+	if (result != ERROR_0) return result;
+
+	_active = FRAM_AB_NO_SLOT;
+	_generation = 0;
+	*length = 0;
+
+	// newest first - generation comparison is wrap safe
+	uint8_t order[2] = { 0, 1 };
+	if ((int32_t)(headers[1].generation - headers[0].generation) > 0) {
+		order[0] = 1;
+		order[1] = 0;
+	}
+
+	for (uint8_t i = 0; i < 2; i++) {
+		FramABHeader *header = &headers[order[i]];
+		if ((header->length == 0) || (header->length > _size)) continue;
+
+		result = _fram->readBlock(FramABRecord::slotAddress(order[i]), header->length, data);
+		if (result != ERROR_0) return result;
+
+		if (FramABRecord::recordCrc(header, data) == header->crc) {
+			_active = order[i];
+			_generation = header->generation;
+			*length = header->length;
+			return ERROR_0;
+		}
+	}
+	return ERROR_12;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Saves a new copy : data are written to the inactive slot, then its header is flipped
+
+    @params[in] data[]
+                Record to save
+    @params[in] length
+                Length of the record, up to recordSize
+    @returns
+				0: success
+				8: null length
+				11: record larger than recordSize or region out of memory map
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramABRecord::save(uint8_t data[], uint16_t length)
+{
+	if (length == 0) return ERROR_8;
+	if (length > _size) return ERROR_11;
+
+	uint8_t target = (_active == 0) ? 1 : 0;
+
+	FramABHeader header;
+	header.generation = _generation + 1;
+	header.length = length;
+	header.crc = FramABRecord::recordCrc(&header, data);
+
+	byte result = _fram->writeBlock(FramABRecord::slotAddress(target), length, data);
+	if (result == ERROR_0) {
+		result = _fram->writeArray(_base + target * FRAM_AB_HEADER_SIZE, FRAM_AB_HEADER_SIZE, reinterpret_cast<uint8_t *>(&header));
+	}
+	if (result == ERROR_0) {
+		_active = target;
+		_generation = header.generation;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Generation of the active copy, 0 if none
+*/
+/**************************************************************************/
+uint32_t FramABRecord::generation(void)
+{
+	return _generation;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Active slot : 0 (A), 1 (B) or FRAM_AB_NO_SLOT
+*/
+/**************************************************************************/
+uint8_t FramABRecord::activeSlot(void)
+{
+	return _active;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of FRAM bytes used by the record region
+*/
+/**************************************************************************/
+uint16_t FramABRecord::footprint(void)
+{
+	return 2 * FRAM_AB_HEADER_SIZE + 2 * _size;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+uint16_t FramABRecord::slotAddress(uint8_t slot)
+{
+	return _base + 2 * FRAM_AB_HEADER_SIZE + slot * _size;
+}
+
+uint16_t FramABRecord::recordCrc(FramABHeader *header, const uint8_t data[])
+{
+	uint16_t crc = FRAM_MB85RC_I2C::crc16(0xFFFF, reinterpret_cast<const uint8_t *>(&header->generation), sizeof(header->generation));
+	crc = FRAM_MB85RC_I2C::crc16(crc, reinterpret_cast<const uint8_t *>(&header->length), sizeof(header->length));
+	return FRAM_MB85RC_I2C::crc16(crc, data, header->length);
+}
@@ -0,0 +1,59 @@
+/**************************************************************************/
+/*!
+    @file     FramABRecord.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    A/B double buffered record on top of FRAM_MB85RC_I2C.
+    Each save goes to the inactive slot first, then its header is written
+    with the next generation number. A power loss during save leaves the
+    previous copy valid, a torn copy is never returned.
+
+    FRAM layout of a record region :
+      [0..7]   header A : generation (4) - length (2) - CRC (2)
+      [8..15]  header B
+      [16..]   slot A data (recordSize bytes), then slot B data
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_AB_RECORD_H_
+#define _FRAM_AB_RECORD_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+#define FRAM_AB_HEADER_SIZE 8
+#define FRAM_AB_NO_SLOT 0xFF
+
+typedef struct {
+	uint32_t	generation;
+	uint16_t	length;
+	uint16_t	crc;		// CRC of generation, length & data
+} FramABHeader;
+
+
+class FramABRecord {
+ public:
+	FramABRecord(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t recordSize);
+
+	byte	begin(uint8_t data[], uint16_t *length);
+	byte	save(uint8_t data[], uint16_t length);
+
+	uint32_t	generation(void);
+	uint8_t		activeSlot(void);
+	uint16_t	footprint(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint16_t	_size;
+	uint32_t	_generation;
+	uint8_t		_active;
+
+	uint16_t	slotAddress(uint8_t slot);
+	uint16_t	recordCrc(FramABHeader *header, const uint8_t data[]);
+};
+
+#endif
@@ -0,0 +1,247 @@
+/**************************************************************************/
+/*!
+    @file     FramArray.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Typed array view of a FRAM region, usable with standard algorithms.
+    FramArray<T> exposes operator[], FramPtr<T> random access iterators and
+    FramRef<T> reference proxies. Elements are accessed through a RAM
+    window of FRAM_WINDOW_SIZE bytes : sequential access costs one burst per
+    window, modified bytes are written back when the window moves or on flush().
+
+    Two FramArray objects over the same FRAM bytes each have their own window,
+    flush() one before reading through the other.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_ARRAY_H_
+#define _FRAM_ARRAY_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// Window size in bytes - one burst per window move
+#ifndef FRAM_WINDOW_SIZE
+#define FRAM_WINDOW_SIZE FRAM_BURST_SIZE
+#endif
+
+#if !defined(ARDUINO_ARCH_AVR)
+ #include <iterator>
+ #define FRAM_ARRAY_STL 1
+#else
+ #define FRAM_ARRAY_STL 0
+#endif
+
+#define FRAM_NO_WINDOW 0xFFFF
+
+template <typename T> class FramArray;
+
+/**************************************************************************/
+/*!
+    Reference proxy : reads & writes one element through the array window
+*/
+/**************************************************************************/
+template <typename T> class FramRef {
+ public:
+	FramRef(FramArray<T> *array, uint16_t index) : _array(array), _index(index) {}
+
+	operator T() const { return _array->get(_index); }
+	FramRef &operator=(const T &value) { _array->set(_index, value); return *this; }
+	FramRef &operator=(const FramRef &other) { return *this = (T)other; }
+	FramRef &operator+=(const T &value) { return *this = (T)(_array->get(_index) + value); }
+	FramRef &operator-=(const T &value) { return *this = (T)(_array->get(_index) - value); }
+
+	friend void swap(FramRef a, FramRef b) {
+		T tmp = a;
+		a = (T)b;
+		b = tmp;
+	}
+
+ private:
+	FramArray<T>	*_array;
+	uint16_t	_index;
+};
+
+/**************************************************************************/
+/*!
+    Pointer like random access iterator over a FramArray
+*/
+/**************************************************************************/
+template <typename T> class FramPtr {
+ public:
+#if FRAM_ARRAY_STL
+	typedef std::random_access_iterator_tag iterator_category;
+#endif
+	typedef T value_type;
+	typedef long difference_type;
+	typedef FramRef<T> reference;
+	typedef FramRef<T> *pointer;
+
+	FramPtr() : _array(NULL), _index(0) {}
+	FramPtr(FramArray<T> *array, uint16_t index) : _array(array), _index(index) {}
+
+	FramRef<T> operator*() const { return FramRef<T>(_array, _index); }
+	FramRef<T> operator[](difference_type n) const { return FramRef<T>(_array, (uint16_t)(_index + n)); }
+
+	FramPtr &operator++() { _index++; return *this; }
+	FramPtr operator++(int) { FramPtr tmp = *this; _index++; return tmp; }
+	FramPtr &operator--() { _index--; return *this; }
+	FramPtr operator--(int) { FramPtr tmp = *this; _index--; return tmp; }
+	FramPtr &operator+=(difference_type n) { _index += n; return *this; }
+	FramPtr &operator-=(difference_type n) { _index -= n; return *this; }
+	FramPtr operator+(difference_type n) const { return FramPtr(_array, (uint16_t)(_index + n)); }
+	FramPtr operator-(difference_type n) const { return FramPtr(_array, (uint16_t)(_index - n)); }
+	friend FramPtr operator+(difference_type n, const FramPtr &p) { return p + n; }
+	difference_type operator-(const FramPtr &other) const { return (difference_type)_index - (difference_type)other._index; }
+
+	bool operator==(const FramPtr &other) const { return _index == other._index; }
+	bool operator!=(const FramPtr &other) const { return _index != other._index; }
+	bool operator<(const FramPtr &other) const { return _index < other._index; }
+	bool operator>(const FramPtr &other) const { return _index > other._index; }
+	bool operator<=(const FramPtr &other) const { return _index <= other._index; }
+	bool operator>=(const FramPtr &other) const { return _index >= other._index; }
+
+	uint16_t	index(void) const { return _index; }
+
+ private:
+	FramArray<T>	*_array;
+	uint16_t	_index;
+};
+
+/**************************************************************************/
+/*!
+    Array of count elements of type T stored from baseAddr
+*/
+/**************************************************************************/
+template <typename T> class FramArray {
+ public:
+	typedef FramPtr<T> iterator;
+
+	FramArray(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t count)
+		: _fram(fram), _base(baseAddr), _count(count), _window(FRAM_NO_WINDOW), _dirtyLo(0), _dirtyHi(0), _status(ERROR_0) {}
+	~FramArray() { flush(); }
+
+	FramRef<T> operator[](uint16_t index) { return FramRef<T>(this, index); }
+	FramPtr<T> begin(void) { return FramPtr<T>(this, 0); }
+	FramPtr<T> end(void) { return FramPtr<T>(this, _count); }
+	uint16_t size(void) const { return _count; }
+
+	/**************************************************************************/
+	/*!
+	    @brief  Reads one element. Bus errors are reported by status(), the element reads as 0
+	*/
+	/**************************************************************************/
+	T get(uint16_t index) {
+		T value;
+		if ((index < _count) && loadWindow(index)) {
+			memcpy(&value, &_buf[offset(index)], sizeof(T));
+		}
+		else {
+			memset(&value, 0, sizeof(T));
+		}
+		return value;
+	}
+
+	/**************************************************************************/
+	/*!
+	    @brief  Writes one element in the window, written to FRAM when the window moves or on flush()
+
+	    @returns	0: success, 11: index out of range, or last bus error
+	*/
+	/**************************************************************************/
+	byte set(uint16_t index, const T &value) {
+		if (index >= _count) return ERROR_11;
+		if (!loadWindow(index)) return _status;
+
+		uint16_t lo = offset(index);
+		memcpy(&_buf[lo], &value, sizeof(T));
+		if (_dirtyHi == 0) {
+			_dirtyLo = lo;
+			_dirtyHi = lo + sizeof(T);
+		}
+		else {
+			if (lo < _dirtyLo) _dirtyLo = lo;
+			if ((lo + sizeof(T)) > _dirtyHi) _dirtyHi = lo + sizeof(T);
+		}
+		return ERROR_0;
+	}
+
+	/**************************************************************************/
+	/*!
+	    @brief  Writes the modified bytes of the window back to FRAM in one transaction
+	*/
+	/**************************************************************************/
+	byte flush(void) {
+		if (_dirtyHi == 0) return ERROR_0;
+
+		uint16_t addr = _base + (uint16_t)(_window * perWindow() * sizeof(T)) + _dirtyLo;
+		byte result = _fram->writeArray(addr, (byte)(_dirtyHi - _dirtyLo), &_buf[_dirtyLo]);
+		if (result != ERROR_0) _status = result;
+		_dirtyLo = 0;
+		_dirtyHi = 0;
+		return result;
+	}
+
+	/**************************************************************************/
+	/*!
+	    @brief  Flushes and drops the window - next access reloads it from FRAM
+	*/
+	/**************************************************************************/
+	byte invalidate(void) {
+		byte result = flush();
+		_window = FRAM_NO_WINDOW;
+		return result;
+	}
+
+	/**************************************************************************/
+	/*!
+	    @brief  Last bus error met by an element access (proxies cannot return it), cleared on read
+	*/
+	/**************************************************************************/
+	byte status(void) {
+		byte result = _status;
+		_status = ERROR_0;
+		return result;
+	}
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint16_t	_count;
+	uint16_t	_window;	// index of the window held in _buf
+	uint16_t	_dirtyLo;	// modified bytes range in _buf, empty when _dirtyHi is 0
+	uint16_t	_dirtyHi;
+	byte		_status;
+	uint8_t		_buf[FRAM_WINDOW_SIZE];
+
+#if __cplusplus >= 201103L
+	static_assert(sizeof(T) <= FRAM_WINDOW_SIZE, "FramArray element larger than FRAM_WINDOW_SIZE");
+#endif
+
+	static uint16_t perWindow(void) { return FRAM_WINDOW_SIZE / sizeof(T); }
+	static uint16_t offset(uint16_t index) { return (index % perWindow()) * sizeof(T); }
+
+	boolean loadWindow(uint16_t index) {
+		uint16_t window = index / perWindow();
+		if (window == _window) return true;
+
+		flush();
+		uint16_t first = window * perWindow();
+		uint16_t n = _count - first;
+		if (n > perWindow()) n = perWindow();
+
+		byte result = _fram->readArray(_base + first * sizeof(T), (byte)(n * sizeof(T)), _buf);
+		if (result != ERROR_0) {
+			_status = result;
+			_window = FRAM_NO_WINDOW;
+			return false;
+		}
+		_window = window;
+		return true;
+	}
+};
+
+#endif
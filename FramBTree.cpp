@@ -0,0 +1,651 @@
+/**************************************************************************/
+/*!
+    @file     FramBTree.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Persistent B+tree index on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramBTree.h"
+
+#define LEAF_OFF(i) (FRAM_BTREE_NODE_HEADER + (i) * FRAM_BTREE_LEAF_ENTRY)
+#define INNER_OFF(i) (FRAM_BTREE_NODE_HEADER + (i) * FRAM_BTREE_INNER_ENTRY)
+
+// Node fields are not aligned, copied rather than cast
+static FramBTreeKey getKey(const uint8_t *p)
+{
+	FramBTreeKey key;
+	memcpy(&key, p, sizeof(key));
+	return key;
+}
+
+static uint16_t getLink(const uint8_t *p)
+{
+	uint16_t node;
+	memcpy(&node, p, sizeof(node));
+	return node;
+}
+
+static void putLink(uint8_t *p, uint16_t node)
+{
+	memcpy(p, &node, sizeof(node));
+}
+
+// First entry of a leaf whose key is not lower than key
+static uint8_t leafSearch(const uint8_t data[], FramBTreeKey key)
+{
+	uint8_t lo = 0;
+	uint8_t hi = data[1];
+	while (lo < hi) {
+		uint8_t mid = (lo + hi) >> 1;
+		if (getKey(&data[LEAF_OFF(mid)]) < key) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+// Child of an inner node to follow for key : number of separators lower or equal to key
+static uint8_t innerSearch(const uint8_t data[], FramBTreeKey key)
+{
+	uint8_t lo = 0;
+	uint8_t hi = data[1];
+	while (lo < hi) {
+		uint8_t mid = (lo + hi) >> 1;
+		if (getKey(&data[INNER_OFF(mid)]) <= key) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+static uint16_t innerChild(const uint8_t data[], uint8_t child)
+{
+	if (child == 0) return getLink(&data[2]);
+	return getLink(&data[INNER_OFF(child - 1) + sizeof(FramBTreeKey)]);
+}
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the tree lives on
+    @params[in] baseAddr
+                First address of the tree region
+    @params[in] size
+                Size of the region, header included
+*/
+/**************************************************************************/
+FramBTree::FramBTree(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_valid = false;
+	_clock = 0;
+	_reads = 0;
+	_hits = 0;
+	memset(&_header, 0, sizeof(_header));
+
+	uint32_t nodes = (size > FRAM_BTREE_HEADER_SIZE) ? (size - FRAM_BTREE_HEADER_SIZE) / FRAM_BTREE_NODE_SIZE : 0;
+	if (((uint32_t)baseAddr + size) > 0x10000UL) nodes = 0;
+	if (nodes >= FRAM_BTREE_NO_NODE) nodes = FRAM_BTREE_NO_NODE - 1;
+	_capacity = (uint16_t)nodes;
+
+	FramBTree::clearCache();
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Loads the tree header, the cache fills up while the tree is used
+
+    @returns
+				0: success
+				10: region too small for a single node
+				12: region not formatted with this node size & key / value types - call format()
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramBTree::begin(void)
+{
+	_valid = false;
+	FramBTree::clearCache();
+	if (_capacity == 0) return ERROR_10;
+
+	byte result = _fram->readArray(_base, FRAM_BTREE_HEADER_SIZE, reinterpret_cast<uint8_t *>(&_header));
+	if (result != ERROR_0) return result;
+
+	if ((_header.signature != FramBTree::signature()) || (_header.height == 0) || (_header.height > FRAM_BTREE_MAX_HEIGHT)
+		|| (_header.nodes > _capacity) || (_header.root >= _header.nodes)) {
+		memset(&_header, 0, sizeof(_header));
+		return ERROR_12;
+	}
+	_valid = true;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Creates an empty tree : a single empty leaf as root
+
+    @returns
+				0: success
+				10: region too small for a single node
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramBTree::format(void)
+{
+	_valid = false;
+	FramBTree::clearCache();
+	if (_capacity == 0) return ERROR_10;
+
+	uint8_t data[FRAM_BTREE_NODE_SIZE];
+	memset(data, 0, sizeof(data));
+	putLink(&data[2], FRAM_BTREE_NO_NODE);
+	byte result = _fram->writeArray(FramBTree::nodeAddr(0), FRAM_BTREE_NODE_HEADER, data);
+	if (result != ERROR_0) return result;
+
+	_header.signature = FramBTree::signature();
+	_header.root = 0;
+	_header.nodes = 1;
+	_header.height = 1;
+	_header.reserved = 0;
+	_header.entries = 0;
+	result = FramBTree::writeHeader();
+	_valid = (result == ERROR_0);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Inserts a key, or updates its value when the key exists.
+			An update writes the value bytes only, an insert the shifted part of the leaf,
+			a split the nodes created & modified.
+
+    @params[in] key
+                Key to insert
+    @params[in] value
+                Value associated
+    @returns
+				0: success
+				10: tree not loaded (begin() / format())
+				11: region full
+				12: node inconsistent with the tree structure
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramBTree::insert(FramBTreeKey key, FramBTreeValue value)
+{
+	if (!_valid) return ERROR_10;
+
+	uint16_t path[FRAM_BTREE_MAX_HEIGHT];
+	uint8_t data[FRAM_BTREE_NODE_SIZE];
+	uint16_t leaf;
+	byte result = FramBTree::descend(key, path, data, &leaf);
+	if (result != ERROR_0) return result;
+
+	uint8_t count = data[1];
+	uint8_t pos = leafSearch(data, key);
+	if ((pos < count) && (getKey(&data[LEAF_OFF(pos)]) == key)) {
+		uint8_t off = LEAF_OFF(pos) + sizeof(FramBTreeKey);
+		memcpy(&data[off], &value, sizeof(value));
+		return FramBTree::writeNode(leaf, data, off, sizeof(value));
+	}
+
+	if (count >= FRAM_BTREE_LEAF_MAX) return FramBTree::splitLeaf(path, leaf, data, pos, key, value);
+
+	memmove(&data[LEAF_OFF(pos + 1)], &data[LEAF_OFF(pos)], (count - pos) * FRAM_BTREE_LEAF_ENTRY);
+	memcpy(&data[LEAF_OFF(pos)], &key, sizeof(key));
+	memcpy(&data[LEAF_OFF(pos) + sizeof(key)], &value, sizeof(value));
+	data[1] = count + 1;
+	// count byte to last entry in one transfer
+	result = FramBTree::writeNode(leaf, data, 1, LEAF_OFF(count + 1) - 1);
+	if (result != ERROR_0) return result;
+
+	_header.entries++;
+	return FramBTree::writeHeader();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks a key up - costs the leaf read once the upper levels are cached
+
+    @params[in] key
+                Key to look for
+    @params[out] value
+                Value associated
+    @returns
+				0: success
+				10: tree not loaded
+				11: key not found
+				12: node inconsistent with the tree structure
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramBTree::find(FramBTreeKey key, FramBTreeValue *value)
+{
+	if (!_valid) return ERROR_10;
+
+	uint16_t path[FRAM_BTREE_MAX_HEIGHT];
+	uint8_t data[FRAM_BTREE_NODE_SIZE];
+	uint16_t leaf;
+	byte result = FramBTree::descend(key, path, data, &leaf);
+	if (result != ERROR_0) return result;
+
+	uint8_t pos = leafSearch(data, key);
+	if ((pos >= data[1]) || (getKey(&data[LEAF_OFF(pos)]) != key)) return ERROR_11;
+	memcpy(value, &data[LEAF_OFF(pos) + sizeof(FramBTreeKey)], sizeof(FramBTreeValue));
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes a key. The leaf is not merged with its neighbours.
+
+    @params[in] key
+                Key to remove
+    @returns
+				0: success
+				10: tree not loaded
+				11: key not found
+				12: node inconsistent with the tree structure
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramBTree::remove(FramBTreeKey key)
+{
+	if (!_valid) return ERROR_10;
+
+	uint16_t path[FRAM_BTREE_MAX_HEIGHT];
+	uint8_t data[FRAM_BTREE_NODE_SIZE];
+	uint16_t leaf;
+	byte result = FramBTree::descend(key, path, data, &leaf);
+	if (result != ERROR_0) return result;
+
+	uint8_t count = data[1];
+	uint8_t pos = leafSearch(data, key);
+	if ((pos >= count) || (getKey(&data[LEAF_OFF(pos)]) != key)) return ERROR_11;
+
+	memmove(&data[LEAF_OFF(pos)], &data[LEAF_OFF(pos + 1)], (count - pos - 1) * FRAM_BTREE_LEAF_ENTRY);
+	data[1] = count - 1;
+	if (pos == count - 1) {
+		result = FramBTree::writeNode(leaf, data, 1, 1);
+	}
+	else {
+		result = FramBTree::writeNode(leaf, data, 1, LEAF_OFF(count - 1) - 1);
+	}
+	if (result != ERROR_0) return result;
+
+	_header.entries--;
+	return FramBTree::writeHeader();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ordered scan of the keys in [lo, hi], following the leaves chain.
+			Call again from the last key found + 1 to get the next results.
+
+    @params[in] lo
+                Lowest key
+    @params[in] hi
+                Highest key, included
+    @params[out] keys[]
+                Keys found, in ascending order
+    @params[out] values[]
+                Values of the keys found
+    @params[in] max
+                Room in keys[] & values[]
+    @params[out] found
+                Number of keys returned
+    @returns
+				0: success
+				10: tree not loaded
+				12: node inconsistent with the tree structure
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramBTree::range(FramBTreeKey lo, FramBTreeKey hi, FramBTreeKey keys[], FramBTreeValue values[], uint16_t max, uint16_t *found)
+{
+	*found = 0;
+	if (!_valid) return ERROR_10;
+	if ((hi < lo) || (max == 0)) return ERROR_0;
+
+	uint16_t path[FRAM_BTREE_MAX_HEIGHT];
+	uint8_t data[FRAM_BTREE_NODE_SIZE];
+	uint16_t leaf;
+	byte result = FramBTree::descend(lo, path, data, &leaf);
+	if (result != ERROR_0) return result;
+
+	uint8_t pos = leafSearch(data, lo);
+	while (true) {
+		for (; pos < data[1]; pos++) {
+			FramBTreeKey key = getKey(&data[LEAF_OFF(pos)]);
+			if ((key > hi) || (*found >= max)) return ERROR_0;
+			keys[*found] = key;
+			memcpy(&values[*found], &data[LEAF_OFF(pos) + sizeof(FramBTreeKey)], sizeof(FramBTreeValue));
+			(*found)++;
+		}
+		leaf = getLink(&data[2]);
+		if (leaf == FRAM_BTREE_NO_NODE) return ERROR_0;
+		result = FramBTree::readNode(leaf, data);
+		if (result != ERROR_0) return result;
+		if (data[0] != 0) return ERROR_12;
+		pos = 0;
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of keys in the tree
+*/
+/**************************************************************************/
+uint32_t FramBTree::entries(void)
+{
+	return _header.entries;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of levels, 1 when the root is a leaf
+*/
+/**************************************************************************/
+uint8_t FramBTree::height(void)
+{
+	return _header.height;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of nodes allocated in the region
+*/
+/**************************************************************************/
+uint16_t FramBTree::nodesUsed(void)
+{
+	return _header.nodes;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of nodes the region can hold
+*/
+/**************************************************************************/
+uint16_t FramBTree::capacity(void)
+{
+	return _capacity;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of nodes read from the chip - one burst each
+*/
+/**************************************************************************/
+uint32_t FramBTree::nodeReads(void)
+{
+	return _reads;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of nodes served from the RAM cache
+*/
+/**************************************************************************/
+uint32_t FramBTree::cacheHits(void)
+{
+	return _hits;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Layout signature : node size, key & value sizes
+*/
+/**************************************************************************/
+uint16_t FramBTree::signature(void)
+{
+	uint8_t layout[4] = { 0xB7, FRAM_BTREE_NODE_SIZE, sizeof(FramBTreeKey), sizeof(FramBTreeValue) };
+	return FRAM_MB85RC_I2C::crc16(0xFFFF, layout, sizeof(layout));
+}
+
+/**************************************************************************/
+/*!
+    @brief  FRAM address of a node
+*/
+/**************************************************************************/
+uint16_t FramBTree::nodeAddr(uint16_t node)
+{
+	return _base + FRAM_BTREE_HEADER_SIZE + node * FRAM_BTREE_NODE_SIZE;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the tree header in one transaction
+*/
+/**************************************************************************/
+byte FramBTree::writeHeader(void)
+{
+	return _fram->writeArray(_base, FRAM_BTREE_HEADER_SIZE, reinterpret_cast<uint8_t *>(&_header));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a node from the cache, or reads it in one burst and caches it.
+			The victim is the least recently used node of the lowest level, leaves go first.
+*/
+/**************************************************************************/
+byte FramBTree::readNode(uint16_t node, uint8_t data[])
+{
+	uint8_t victim = 0;
+	_clock++;
+	for (uint8_t i = 0; i < FRAM_BTREE_CACHE; i++) {
+		FramBTreeCacheEntry *e = &_cache[i];
+		if (e->node == node) {
+			e->stamp = _clock;
+			memcpy(data, e->data, FRAM_BTREE_NODE_SIZE);
+			_hits++;
+			return ERROR_0;
+		}
+		FramBTreeCacheEntry *v = &_cache[victim];
+		if (v->node == FRAM_BTREE_NO_NODE) continue;
+		if ((e->node == FRAM_BTREE_NO_NODE) || (e->data[0] < v->data[0])
+			|| ((e->data[0] == v->data[0]) && (e->stamp < v->stamp))) victim = i;
+	}
+
+	if (node >= _header.nodes) return ERROR_12;
+	byte result = _fram->readArray(FramBTree::nodeAddr(node), FRAM_BTREE_NODE_SIZE, data);
+	if (result != ERROR_0) return result;
+	_reads++;
+
+	FramBTreeCacheEntry *v = &_cache[victim];
+	v->node = node;
+	v->stamp = _clock;
+	memcpy(v->data, data, FRAM_BTREE_NODE_SIZE);
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the modified bytes of a node, the cached copy (if any) is refreshed.
+			Nodes written are not added to the cache. A node past the region is refused.
+*/
+/**************************************************************************/
+byte FramBTree::writeNode(uint16_t node, uint8_t data[], uint8_t from, uint8_t items)
+{
+	if (node >= _capacity) return ERROR_11;
+
+	byte result = _fram->writeArray(FramBTree::nodeAddr(node) + from, items, &data[from]);
+	for (uint8_t i = 0; i < FRAM_BTREE_CACHE; i++) {
+		if (_cache[i].node == node) {
+			if (result == ERROR_0) memcpy(_cache[i].data, data, FRAM_BTREE_NODE_SIZE);
+			else _cache[i].node = FRAM_BTREE_NO_NODE;	// chip content unknown
+		}
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Walks from the root to the leaf holding key, path[level] receives the inner nodes crossed
+*/
+/**************************************************************************/
+byte FramBTree::descend(FramBTreeKey key, uint16_t path[], uint8_t data[], uint16_t *leaf)
+{
+	uint16_t node = _header.root;
+	for (uint8_t level = _header.height - 1; level > 0; level--) {
+		path[level] = node;
+		byte result = FramBTree::readNode(node, data);
+		if (result != ERROR_0) return result;
+		if ((data[0] != level) || (data[1] > FRAM_BTREE_INNER_MAX)) return ERROR_12;
+		node = innerChild(data, innerSearch(data, key));
+	}
+	*leaf = node;
+	byte result = FramBTree::readNode(node, data);
+	if (result != ERROR_0) return result;
+	if ((data[0] != 0) || (data[1] > FRAM_BTREE_LEAF_MAX)) return ERROR_12;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Splits a full leaf in two while inserting key, the new right leaf is linked after it.
+			Appending past the last leaf keeps it full and starts a new one, so ascending keys
+			(IDs, timestamps) fill the nodes rather than leaving them half empty.
+			Room for a split up to the root is checked first, a full region fails before any write.
+*/
+/**************************************************************************/
+byte FramBTree::splitLeaf(uint16_t path[], uint16_t leaf, uint8_t data[], uint8_t pos, FramBTreeKey key, FramBTreeValue value)
+{
+	// new leaf, one new node per inner level, new root
+	if (((uint32_t)_header.nodes + _header.height + 1) > _capacity) return ERROR_11;
+
+	const uint8_t total = FRAM_BTREE_LEAF_MAX + 1;
+	boolean append = (pos == FRAM_BTREE_LEAF_MAX) && (getLink(&data[2]) == FRAM_BTREE_NO_NODE);
+	const uint8_t keep = append ? FRAM_BTREE_LEAF_MAX : (total + 1) / 2;
+	uint8_t entries[total * FRAM_BTREE_LEAF_ENTRY];
+	memcpy(entries, &data[LEAF_OFF(0)], pos * FRAM_BTREE_LEAF_ENTRY);
+	memcpy(&entries[pos * FRAM_BTREE_LEAF_ENTRY], &key, sizeof(key));
+	memcpy(&entries[pos * FRAM_BTREE_LEAF_ENTRY + sizeof(key)], &value, sizeof(value));
+	memcpy(&entries[(pos + 1) * FRAM_BTREE_LEAF_ENTRY], &data[LEAF_OFF(pos)], (FRAM_BTREE_LEAF_MAX - pos) * FRAM_BTREE_LEAF_ENTRY);
+
+	uint16_t rightNode = _header.nodes++;
+	uint8_t right[FRAM_BTREE_NODE_SIZE];
+	memset(right, 0, sizeof(right));
+	right[1] = total - keep;
+	memcpy(&right[2], &data[2], 2);		// inherits the next link
+	memcpy(&right[LEAF_OFF(0)], &entries[keep * FRAM_BTREE_LEAF_ENTRY], (total - keep) * FRAM_BTREE_LEAF_ENTRY);
+
+	data[1] = keep;
+	putLink(&data[2], rightNode);
+	memcpy(&data[LEAF_OFF(0)], entries, keep * FRAM_BTREE_LEAF_ENTRY);
+
+	// new node first : a reset before the link is written only leaks it
+	byte result = FramBTree::writeNode(rightNode, right, 0, LEAF_OFF(total - keep));
+	if (result == ERROR_0) result = FramBTree::writeNode(leaf, data, 1, LEAF_OFF(keep) - 1);
+	if (result != ERROR_0) return result;
+
+	_header.entries++;
+	return FramBTree::insertInner(path, getKey(&right[LEAF_OFF(0)]), rightNode, append);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a separator & its right child in the parents, splitting them as needed,
+			a new root is created when the root splits. Writes the header.
+			When appending, a full node keeps all its keys and the new node starts with the new child only.
+*/
+/**************************************************************************/
+byte FramBTree::insertInner(uint16_t path[], FramBTreeKey key, uint16_t child, boolean append)
+{
+	uint8_t data[FRAM_BTREE_NODE_SIZE];
+	byte result;
+
+	for (uint8_t level = 1; ; level++) {
+		if (level == _header.height) {
+			// root split : the tree grows by one level
+			uint16_t root = _header.nodes++;
+			memset(data, 0, sizeof(data));
+			data[0] = level;
+			data[1] = 1;
+			putLink(&data[2], _header.root);
+			memcpy(&data[INNER_OFF(0)], &key, sizeof(key));
+			putLink(&data[INNER_OFF(0) + sizeof(key)], child);
+			result = FramBTree::writeNode(root, data, 0, INNER_OFF(1));
+			if (result != ERROR_0) return result;
+			_header.root = root;
+			_header.height++;
+			break;
+		}
+
+		uint16_t node = path[level];
+		result = FramBTree::readNode(node, data);
+		if (result != ERROR_0) return result;
+
+		uint8_t count = data[1];
+		uint8_t pos = innerSearch(data, key);
+		if (count < FRAM_BTREE_INNER_MAX) {
+			memmove(&data[INNER_OFF(pos + 1)], &data[INNER_OFF(pos)], (count - pos) * FRAM_BTREE_INNER_ENTRY);
+			memcpy(&data[INNER_OFF(pos)], &key, sizeof(key));
+			putLink(&data[INNER_OFF(pos) + sizeof(key)], child);
+			data[1] = count + 1;
+			result = FramBTree::writeNode(node, data, 1, INNER_OFF(count + 1) - 1);
+			if (result != ERROR_0) return result;
+			break;
+		}
+
+		// full : the middle separator moves up, its child becomes the first child of the new node
+		const uint8_t total = FRAM_BTREE_INNER_MAX + 1;
+		const uint8_t mid = (append && (pos == FRAM_BTREE_INNER_MAX)) ? FRAM_BTREE_INNER_MAX : total / 2;
+		uint8_t entries[total * FRAM_BTREE_INNER_ENTRY];
+		memcpy(entries, &data[INNER_OFF(0)], pos * FRAM_BTREE_INNER_ENTRY);
+		memcpy(&entries[pos * FRAM_BTREE_INNER_ENTRY], &key, sizeof(key));
+		putLink(&entries[pos * FRAM_BTREE_INNER_ENTRY + sizeof(key)], child);
+		memcpy(&entries[(pos + 1) * FRAM_BTREE_INNER_ENTRY], &data[INNER_OFF(pos)], (FRAM_BTREE_INNER_MAX - pos) * FRAM_BTREE_INNER_ENTRY);
+
+		uint16_t rightNode = _header.nodes++;
+		uint8_t right[FRAM_BTREE_NODE_SIZE];
+		memset(right, 0, sizeof(right));
+		right[0] = level;
+		right[1] = total - mid - 1;
+		memcpy(&right[2], &entries[mid * FRAM_BTREE_INNER_ENTRY + sizeof(key)], 2);
+		memcpy(&right[INNER_OFF(0)], &entries[(mid + 1) * FRAM_BTREE_INNER_ENTRY], (total - mid - 1) * FRAM_BTREE_INNER_ENTRY);
+
+		data[1] = mid;
+		memcpy(&data[INNER_OFF(0)], entries, mid * FRAM_BTREE_INNER_ENTRY);
+
+		result = FramBTree::writeNode(rightNode, right, 0, INNER_OFF(total - mid - 1));
+		if (result == ERROR_0) result = FramBTree::writeNode(node, data, 1, INNER_OFF(mid) - 1);
+		if (result != ERROR_0) return result;
+
+		key = getKey(&entries[mid * FRAM_BTREE_INNER_ENTRY]);
+		child = rightNode;
+	}
+	return FramBTree::writeHeader();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drops every cached node
+*/
+/**************************************************************************/
+void FramBTree::clearCache(void)
+{
+	for (uint8_t i = 0; i < FRAM_BTREE_CACHE; i++) {
+		_cache[i].node = FRAM_BTREE_NO_NODE;
+		_cache[i].stamp = 0;
+	}
+}
@@ -0,0 +1,141 @@
+/**************************************************************************/
+/*!
+    @file     FramBTree.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Persistent B+tree index on top of FRAM_MB85RC_I2C : ordered keys, point
+    lookups and range scans. Nodes have a fixed size of one bus burst and are
+    read in one transfer. A RAM cache keeps the hot nodes, leaves are evicted
+    first so the root and upper levels stay in RAM : a lookup costs the leaf
+    read only once the upper levels fit the cache. Updates write back only the
+    bytes changed in the nodes modified.
+
+    Removal does not merge underfull nodes, the room left is reused by later
+    inserts into the same leaf.
+
+    Keys inserted in ascending order (IDs, timestamps) fill the nodes, random
+    order leaves them about 2/3 full. With 126 bytes nodes (ESP32 Wire buffer)
+    and a cache of 20 nodes, 10k ascending keys take about 44 KB of a 512K
+    part with FRAM_BTREE_KEY_TYPE uint16_t, and a lookup costs one burst.
+    With the default uint32_t keys, a whole 512K part holds about 9.7k
+    ascending keys (see extras/host/test_btree.cpp to size a region).
+
+    FRAM layout of a tree region :
+      [0..11]  header : signature (2) - root (2) - nodes used (2) - height (1) - reserved (1) - entries (4)
+      [12..]   nodes, FRAM_BTREE_NODE_SIZE bytes each
+
+    Node layout :
+      [0]      level, 0 for leaves
+      [1]      number of keys
+      [2..3]   leaf : next leaf - inner node : first child
+      [4..]    leaf : key - value pairs - inner node : key - right child pairs
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_BTREE_H_
+#define _FRAM_BTREE_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// Key & value types - fixed size, changing them changes the layout signature
+#ifndef FRAM_BTREE_KEY_TYPE
+#define FRAM_BTREE_KEY_TYPE uint32_t
+#endif
+#ifndef FRAM_BTREE_VALUE_TYPE
+#define FRAM_BTREE_VALUE_TYPE uint16_t	// typically the FRAM address of the record
+#endif
+
+// Node size - one burst per node read
+#ifndef FRAM_BTREE_NODE_SIZE
+#define FRAM_BTREE_NODE_SIZE FRAM_BURST_SIZE
+#endif
+
+// RAM budget : nodes kept in cache
+#ifndef FRAM_BTREE_CACHE
+ #if defined(ARDUINO_ARCH_AVR)
+  #define FRAM_BTREE_CACHE 4
+ #else
+  #define FRAM_BTREE_CACHE 20
+ #endif
+#endif
+
+#define FRAM_BTREE_MAX_HEIGHT 8
+#define FRAM_BTREE_HEADER_SIZE 12
+#define FRAM_BTREE_NODE_HEADER 4
+#define FRAM_BTREE_NO_NODE 0xFFFF
+
+typedef FRAM_BTREE_KEY_TYPE FramBTreeKey;
+typedef FRAM_BTREE_VALUE_TYPE FramBTreeValue;
+
+#define FRAM_BTREE_LEAF_ENTRY (sizeof(FramBTreeKey) + sizeof(FramBTreeValue))
+#define FRAM_BTREE_INNER_ENTRY (sizeof(FramBTreeKey) + 2)
+#define FRAM_BTREE_LEAF_MAX ((FRAM_BTREE_NODE_SIZE - FRAM_BTREE_NODE_HEADER) / FRAM_BTREE_LEAF_ENTRY)
+#define FRAM_BTREE_INNER_MAX ((FRAM_BTREE_NODE_SIZE - FRAM_BTREE_NODE_HEADER) / FRAM_BTREE_INNER_ENTRY)
+
+typedef struct {
+	uint16_t	signature;
+	uint16_t	root;
+	uint16_t	nodes;
+	uint8_t		height;
+	uint8_t		reserved;
+	uint32_t	entries;
+} FramBTreeHeader;
+
+typedef struct {
+	uint16_t	node;		// FRAM_BTREE_NO_NODE when free
+	uint32_t	stamp;		// last use
+	uint8_t		data[FRAM_BTREE_NODE_SIZE];
+} FramBTreeCacheEntry;
+
+
+class FramBTree {
+ public:
+	FramBTree(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size);
+
+	byte	begin(void);
+	byte	format(void);
+	byte	insert(FramBTreeKey key, FramBTreeValue value);
+	byte	find(FramBTreeKey key, FramBTreeValue *value);
+	byte	remove(FramBTreeKey key);
+	byte	range(FramBTreeKey lo, FramBTreeKey hi, FramBTreeKey keys[], FramBTreeValue values[], uint16_t max, uint16_t *found);
+
+	uint32_t	entries(void);
+	uint8_t		height(void);
+	uint16_t	nodesUsed(void);
+	uint16_t	capacity(void);
+	uint32_t	nodeReads(void);
+	uint32_t	cacheHits(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint16_t	_capacity;
+	boolean		_valid;
+	FramBTreeHeader	_header;
+	FramBTreeCacheEntry	_cache[FRAM_BTREE_CACHE];
+	uint32_t	_clock;
+	uint32_t	_reads;
+	uint32_t	_hits;
+
+#if __cplusplus >= 201103L
+	static_assert(FRAM_BTREE_NODE_SIZE <= 255, "FRAM_BTREE_NODE_SIZE larger than a readArray() transfer");
+	static_assert(FRAM_BTREE_LEAF_MAX >= 3, "FRAM_BTREE_NODE_SIZE too small for the key & value types");
+	static_assert(FRAM_BTREE_INNER_MAX >= 3, "FRAM_BTREE_NODE_SIZE too small for the key type");
+#endif
+
+	uint16_t	signature(void);
+	uint16_t	nodeAddr(uint16_t node);
+	byte		writeHeader(void);
+	byte		readNode(uint16_t node, uint8_t data[]);
+	byte		writeNode(uint16_t node, uint8_t data[], uint8_t from, uint8_t items);
+	byte		descend(FramBTreeKey key, uint16_t path[], uint8_t data[], uint16_t *leaf);
+	byte		splitLeaf(uint16_t path[], uint16_t leaf, uint8_t data[], uint8_t pos, FramBTreeKey key, FramBTreeValue value);
+	byte		insertInner(uint16_t path[], FramBTreeKey key, uint16_t child, boolean append);
+	void		clearCache(void);
+};
+
+#endif
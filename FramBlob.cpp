@@ -0,0 +1,365 @@
+/**************************************************************************/
+/*!
+    @file     FramBlob.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Compressed blob storage on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramBlob.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the blob lives on
+    @params[in] baseAddr
+                First address of the blob region (header included)
+    @params[in] capacity
+                Size of the blob region in bytes (header included)
+*/
+/**************************************************************************/
+FramBlob::FramBlob(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t capacity)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_capacity = capacity;
+	_rawLength = 0;
+	_storedLength = 0;
+	_status = ERROR_0;
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Starts a new blob, previous content is overwritten
+
+    @returns
+				0: success
+				11: region too small to hold even the header
+*/
+/**************************************************************************/
+byte FramBlob::beginWrite(void)
+{
+	if (_capacity <= FRAM_BLOB_HEADER_SIZE) return ERROR_11;
+
+	_status = ERROR_0;
+	_rawLength = 0;
+	_storedLength = 0;
+	_burstLen = 0;
+	_streamPos = 0;
+	_bitBuffer = 0;
+	_bitCount = 0;
+	_ringPos = 0;
+	_pending = 0;
+	_history = 0;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compresses a chunk of data to the blob. Can be called as many times as needed
+
+    @params[in] data[]
+                Bytes to store
+    @params[in] len
+                Number of bytes to store
+    @returns
+				return code of the last FRAM write
+				11: compressed blob does not fit the region
+*/
+/**************************************************************************/
+byte FramBlob::write(const uint8_t data[], uint16_t len)
+{
+	for (uint16_t i = 0; (i < len) && (_status == ERROR_0); i++) {
+		if (_rawLength == 0xFFFF) {
+			_status = ERROR_11;
+			break;
+		}
+		_ring[(_ringPos + _pending) % FRAM_BLOB_RING_SIZE] = data[i];
+		_pending++;
+		_rawLength++;
+		if (_pending == FRAM_BLOB_MAX_MATCH) FramBlob::encodeStep();
+	}
+	return _status;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Encodes the remaining lookahead, flushes the stream and writes the blob header
+
+    @returns
+				return code of the last FRAM write
+				11: compressed blob does not fit the region
+*/
+/**************************************************************************/
+byte FramBlob::endWrite(void)
+{
+	while ((_pending > 0) && (_status == ERROR_0)) {
+		FramBlob::encodeStep();
+	}
+	if (_bitCount > 0) FramBlob::putBits(0, 8 - _bitCount);
+	FramBlob::flushBurst();
+
+	if (_status == ERROR_0) {
+		_storedLength = _streamPos;
+		uint16_t header[2] = { _rawLength, _storedLength };
+		_status = _fram->writeArray(_base, FRAM_BLOB_HEADER_SIZE, reinterpret_cast<uint8_t *>(header));
+	}
+	return _status;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the blob header and prepares decompression
+
+    @params[out] rawLength
+                Uncompressed size of the blob
+    @returns
+				return code of Wire.endTransmission()
+				11: header is inconsistent with the region (blob never written)
+*/
+/**************************************************************************/
+byte FramBlob::beginRead(uint16_t *rawLength)
+{
+	uint16_t header[2];
+	_status = _fram->readArray(_base, FRAM_BLOB_HEADER_SIZE, reinterpret_cast<uint8_t *>(header));
+	if (_status != ERROR_0) return _status;
+
+	_rawLength = header[0];
+	_storedLength = header[1];
+	if (_storedLength > (_capacity - FRAM_BLOB_HEADER_SIZE)) {
+		_rawLength = 0;
+		_storedLength = 0;
+		_status = ERROR_11;
+	}
+
+	_burstLen = 0;
+	_burstPos = 0;
+	_streamPos = 0;
+	_bitCount = 0;
+	_ringPos = 0;
+	_copyLeft = 0;
+	_produced = 0;
+	*rawLength = _rawLength;
+	return _status;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Decompresses the next bytes of the blob. Compressed data are fetched from the chip by bursts
+
+    @params[out] data[]
+                Buffer to fill
+    @params[in] len
+                Size of the buffer
+    @params[out] got
+                Number of bytes actually decoded - 0 when the end of the blob is reached
+    @returns
+				return code of Wire.endTransmission()
+				8: compressed stream ended before the blob was complete
+*/
+/**************************************************************************/
+byte FramBlob::read(uint8_t data[], uint16_t len, uint16_t *got)
+{
+	uint16_t n = 0;
+	while ((n < len) && (_produced < _rawLength) && (_status == ERROR_0)) {
+		uint8_t value;
+		if (_copyLeft == 0) {
+			int flag = FramBlob::getBits(1);
+			if (flag < 0) break;
+			if (flag == 1) {
+				int literal = FramBlob::getBits(8);
+				if (literal < 0) break;
+				value = (uint8_t)literal;
+			}
+			else {
+				int dist = FramBlob::getBits(FRAM_BLOB_WINDOW_BITS);
+				int count = FramBlob::getBits(FRAM_BLOB_LOOKAHEAD_BITS);
+				if ((dist < 0) || (count < 0)) break;
+				_copyDist = (uint16_t)dist + 1;
+				_copyLeft = (uint16_t)count + FRAM_BLOB_MIN_MATCH;
+				continue;
+			}
+		}
+		else {
+			value = _ring[(_ringPos - _copyDist) & (FRAM_BLOB_WINDOW_SIZE - 1)];
+			_copyLeft--;
+		}
+		_ring[_ringPos] = value;
+		_ringPos = (_ringPos + 1) & (FRAM_BLOB_WINDOW_SIZE - 1);
+		data[n++] = value;
+		_produced++;
+	}
+	*got = n;
+	return _status;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uncompressed size of the last blob written or opened
+*/
+/**************************************************************************/
+uint16_t FramBlob::rawLength(void)
+{
+	return _rawLength;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compressed size in FRAM (header excluded) of the last blob written or opened
+*/
+/**************************************************************************/
+uint16_t FramBlob::storedLength(void)
+{
+	return _storedLength;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Encodes the head of the lookahead either as a literal or as the longest back reference found in the window
+*/
+/**************************************************************************/
+void FramBlob::encodeStep(void)
+{
+	uint16_t bestLen = 0;
+	uint16_t bestDist = 0;
+
+	for (uint16_t dist = 1; dist <= _history; dist++) {
+		uint16_t src = (_ringPos + FRAM_BLOB_RING_SIZE - dist) % FRAM_BLOB_RING_SIZE;
+		uint16_t len = 0;
+		while ((len < _pending) && (_ring[(src + len) % FRAM_BLOB_RING_SIZE] == _ring[(_ringPos + len) % FRAM_BLOB_RING_SIZE])) {
+			len++;
+		}
+		if (len > bestLen) {
+			bestLen = len;
+			bestDist = dist;
+			if (len == FRAM_BLOB_MAX_MATCH) break;
+		}
+	}
+
+	uint16_t advance;
+	if (bestLen >= FRAM_BLOB_MIN_MATCH) {
+		FramBlob::putBits(0, 1);
+		FramBlob::putBits(bestDist - 1, FRAM_BLOB_WINDOW_BITS);
+		FramBlob::putBits(bestLen - FRAM_BLOB_MIN_MATCH, FRAM_BLOB_LOOKAHEAD_BITS);
+		advance = bestLen;
+	}
+	else {
+		FramBlob::putBits(1, 1);
+		FramBlob::putBits(_ring[_ringPos], 8);
+		advance = 1;
+	}
+
+	_ringPos = (_ringPos + advance) % FRAM_BLOB_RING_SIZE;
+	_pending -= advance;
+	_history += advance;
+	if (_history > FRAM_BLOB_WINDOW_SIZE) _history = FRAM_BLOB_WINDOW_SIZE;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Appends bits (MSB first) to the output stream, full bursts are written to the chip
+*/
+/**************************************************************************/
+void FramBlob::putBits(uint16_t value, uint8_t count)
+{
+	while (count > 0) {
+		count--;
+		_bitBuffer = (_bitBuffer << 1) | ((value >> count) & 0x01);
+		_bitCount++;
+		if (_bitCount == 8) {
+			_burst[_burstLen++] = _bitBuffer;
+			_bitBuffer = 0;
+			_bitCount = 0;
+			if (_burstLen == FRAM_BURST_SIZE) FramBlob::flushBurst();
+		}
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the pending output bytes to the chip in a single transaction
+*/
+/**************************************************************************/
+void FramBlob::flushBurst(void)
+{
+	if ((_burstLen == 0) || (_status != ERROR_0)) return;
+
+	if (((uint32_t)FRAM_BLOB_HEADER_SIZE + _streamPos + _burstLen) > _capacity) {
+		_status = ERROR_11;
+	}
+	else {
+		_status = _fram->writeArray(_base + FRAM_BLOB_HEADER_SIZE + _streamPos, _burstLen, _burst);
+		_streamPos += _burstLen;
+	}
+	_burstLen = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads bits (MSB first) from the input stream, refilling the burst buffer when empty
+
+    @returns    bits value, -1 on error
+*/
+/**************************************************************************/
+int FramBlob::getBits(uint8_t count)
+{
+	int value = 0;
+	while (count > 0) {
+		if (_bitCount == 0) {
+			if ((_burstPos == _burstLen) && (FramBlob::fetchBurst() != ERROR_0)) return -1;
+			_bitBuffer = _burst[_burstPos++];
+			_bitCount = 8;
+		}
+		value = (value << 1) | ((_bitBuffer >> 7) & 0x01);
+		_bitBuffer <<= 1;
+		_bitCount--;
+		count--;
+	}
+	return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Loads the next burst of compressed data from the chip
+
+    @returns
+				return code of Wire.endTransmission()
+				8: no more data in the stream
+*/
+/**************************************************************************/
+byte FramBlob::fetchBurst(void)
+{
+	uint16_t left = _storedLength - _streamPos;
+	uint8_t n = (left > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (uint8_t)left;
+
+	if (n == 0) {
+		_status = ERROR_8;
+	}
+	else {
+		_status = _fram->readArray(_base + FRAM_BLOB_HEADER_SIZE + _streamPos, n, _burst);
+		_streamPos += n;
+		_burstLen = n;
+		_burstPos = 0;
+	}
+	return _status;
+}
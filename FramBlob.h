@@ -0,0 +1,89 @@
+/**************************************************************************/
+/*!
+    @file     FramBlob.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Compressed blob storage on top of FRAM_MB85RC_I2C.
+    Data is compressed on write and decompressed on read by a small LZSS
+    codec (heatshrink bitstream layout) working on a fixed RAM window, so the
+    blob is streamed to / from the chip and never needs to fit in RAM.
+
+    FRAM layout of a blob region :
+      [0..1] raw (uncompressed) length
+      [2..3] stored (compressed) length
+      [4..]  compressed bitstream
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_BLOB_H_
+#define _FRAM_BLOB_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// Codec settings - window of 2^WINDOW_BITS bytes, matches up to 2^LOOKAHEAD_BITS + 1 bytes
+// Both sides of the link (writer & reader) must use the same values
+#ifndef FRAM_BLOB_WINDOW_BITS
+#define FRAM_BLOB_WINDOW_BITS 7
+#endif
+#ifndef FRAM_BLOB_LOOKAHEAD_BITS
+#define FRAM_BLOB_LOOKAHEAD_BITS 4
+#endif
+
+#define FRAM_BLOB_HEADER_SIZE 4
+#define FRAM_BLOB_WINDOW_SIZE (1 << FRAM_BLOB_WINDOW_BITS)
+#define FRAM_BLOB_MIN_MATCH 2
+#define FRAM_BLOB_MAX_MATCH ((1 << FRAM_BLOB_LOOKAHEAD_BITS) + FRAM_BLOB_MIN_MATCH - 1)
+#define FRAM_BLOB_RING_SIZE (FRAM_BLOB_WINDOW_SIZE + FRAM_BLOB_MAX_MATCH)
+
+
+class FramBlob {
+ public:
+	FramBlob(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t capacity);
+
+	byte	beginWrite(void);
+	byte	write(const uint8_t data[], uint16_t len);
+	byte	endWrite(void);
+
+	byte	beginRead(uint16_t *rawLength);
+	byte	read(uint8_t data[], uint16_t len, uint16_t *got);
+
+	uint16_t	rawLength(void);
+	uint16_t	storedLength(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint16_t	_capacity;
+	uint16_t	_rawLength;
+	uint16_t	_storedLength;
+
+	// Bit stream, shared by writer & reader - bytes are moved to / from the chip by bursts
+	uint8_t		_burst[FRAM_BURST_SIZE];
+	uint8_t		_burstLen;
+	uint8_t		_burstPos;
+	uint16_t	_streamPos;		// next stream offset to flush (write) or fetch (read)
+	uint8_t		_bitBuffer;
+	uint8_t		_bitCount;
+	byte		_status;
+
+	// Codec window - ring buffer of history + lookahead (writer) or history only (reader)
+	uint8_t		_ring[FRAM_BLOB_RING_SIZE];
+	uint16_t	_ringPos;
+	uint16_t	_pending;		// writer: lookahead bytes not yet encoded
+	uint16_t	_history;		// writer: valid history bytes behind _ringPos
+	uint16_t	_copyLeft;		// reader: bytes left to copy from a back reference
+	uint16_t	_copyDist;
+	uint16_t	_produced;
+
+	void	encodeStep(void);
+	void	putBits(uint16_t value, uint8_t count);
+	void	flushBurst(void);
+	int		getBits(uint8_t count);
+	byte	fetchBurst(void);
+};
+
+#endif
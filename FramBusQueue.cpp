@@ -0,0 +1,248 @@
+/**************************************************************************/
+/*!
+    @file     FramBusQueue.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Request queue for FRAM shared between RTOS tasks.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramBusQueue.h"
+
+// Short critical section protecting the queue itself - the bus lock is held for whole transfers
+#if defined(ESP32) || defined(ESP_PLATFORM)
+static portMUX_TYPE framQueueMux = portMUX_INITIALIZER_UNLOCKED;
+ #define FRAM_QUEUE_ENTER() portENTER_CRITICAL(&framQueueMux)
+ #define FRAM_QUEUE_EXIT() portEXIT_CRITICAL(&framQueueMux)
+#else
+ #define FRAM_QUEUE_ENTER() noInterrupts()
+ #define FRAM_QUEUE_EXIT() interrupts()
+#endif
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor - one queue per bus
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the requests are executed on
+*/
+/**************************************************************************/
+FramBusQueue::FramBusQueue(FRAM_MB85RC_I2C *fram)
+{
+	_fram = fram;
+	_count = 0;
+	_requests = 0;
+	_transfers = 0;
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Queued version of FRAM_MB85RC_I2C::readArray(), blocks until done
+
+    @params[in] framAddr
+                The 16-bit address to read from in FRAM memory
+	@params[in] items
+				number of items to read from memory chip
+	@params[out] values[]
+				array to be filled in by the memory read
+    @returns
+				return code of FRAM_MB85RC_I2C::readArray() for the merged transfer
+*/
+/**************************************************************************/
+byte FramBusQueue::readArray(uint16_t framAddr, byte items, uint8_t values[])
+{
+	if (items == 0) return ERROR_8;
+
+	FramBusRequest req;
+	req.framAddr = framAddr;
+	req.items = items;
+	req.op = FRAM_QUEUE_READ;
+	req.values = values;
+	return FramBusQueue::submit(&req);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Queued version of FRAM_MB85RC_I2C::writeArray(), blocks until done
+
+    @params[in] framAddr
+                The 16-bit address to write to in FRAM memory
+    @params[in] items
+                The number of items to write from the array
+	@params[in] values[]
+                The array of bytes to write
+    @returns
+				return code of FRAM_MB85RC_I2C::writeArray() for the merged transfer
+*/
+/**************************************************************************/
+byte FramBusQueue::writeArray(uint16_t framAddr, byte items, uint8_t values[])
+{
+	if (items == 0) return ERROR_0;
+
+	FramBusRequest req;
+	req.framAddr = framAddr;
+	req.items = items;
+	req.op = FRAM_QUEUE_WRITE;
+	req.values = values;
+	return FramBusQueue::submit(&req);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of requests posted since creation
+*/
+/**************************************************************************/
+uint32_t FramBusQueue::requestCount(void)
+{
+	return _requests;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of bus transfers actually issued - lower than requestCount() when requests were merged
+*/
+/**************************************************************************/
+uint32_t FramBusQueue::transferCount(void)
+{
+	return _transfers;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Posts a request and waits for the bus. Whoever owns the bus first serves the whole queue,
+			so a request may already be done when its task gets the bus.
+*/
+/**************************************************************************/
+byte FramBusQueue::submit(FramBusRequest *req)
+{
+	req->done = false;
+	req->result = ERROR_0;
+
+	boolean queued = false;
+	while (!queued) {
+		FRAM_QUEUE_ENTER();
+		if (_count < FRAM_QUEUE_DEPTH) {
+			_queue[_count++] = req;
+			_requests++;
+			queued = true;
+		}
+		FRAM_QUEUE_EXIT();
+
+		if (!queued) {
+			// queue full, serve it to make room
+			_fram->busLock();
+			FramBusQueue::drain();
+			_fram->busUnlock();
+		}
+	}
+
+	_fram->busLock();
+	if (!req->done) FramBusQueue::drain();
+	_fram->busUnlock();
+	return req->result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Executes every queued request. Requests are sorted by address and
+			adjacent ones of the same kind are merged up to FRAM_BURST_SIZE bytes.
+			Must be called with the bus lock held.
+*/
+/**************************************************************************/
+void FramBusQueue::drain(void)
+{
+	FramBusRequest *local[FRAM_QUEUE_DEPTH];
+	uint8_t n;
+
+	FRAM_QUEUE_ENTER();
+	n = _count;
+	for (uint8_t i = 0; i < n; i++) local[i] = _queue[i];
+	_count = 0;
+	FRAM_QUEUE_EXIT();
+
+	// Insertion sort by address - stable, the queue is short
+	for (uint8_t i = 1; i < n; i++) {
+		FramBusRequest *r = local[i];
+		uint8_t j = i;
+		while ((j > 0) && (local[j - 1]->framAddr > r->framAddr)) {
+			local[j] = local[j - 1];
+			j--;
+		}
+		local[j] = r;
+	}
+
+	uint8_t i = 0;
+	while (i < n) {
+		uint16_t start = local[i]->framAddr;
+		uint32_t end = (uint32_t)start + local[i]->items;
+		uint8_t j = i + 1;
+		while (j < n) {
+			FramBusRequest *r = local[j];
+			uint32_t rEnd = (uint32_t)r->framAddr + r->items;
+			if (r->op != local[i]->op) break;
+			// writes must be strictly adjacent, reads may also overlap
+			if ((r->op == FRAM_QUEUE_WRITE) ? (r->framAddr != end) : (r->framAddr > end)) break;
+			if (rEnd < end) rEnd = end;
+			if ((rEnd - start) > FRAM_BURST_SIZE) break;
+			end = rEnd;
+			j++;
+		}
+		FramBusQueue::execute(&local[i], j - i, start, (uint16_t)(end - start));
+		i = j;
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Runs one bus transfer for a group of merged requests and dispatches the result
+*/
+/**************************************************************************/
+void FramBusQueue::execute(FramBusRequest *group[], uint8_t n, uint16_t start, uint16_t span)
+{
+	byte result;
+	_transfers++;
+
+	if (n == 1) {
+		// nothing merged, no need to go through the burst buffer
+		if (group[0]->op == FRAM_QUEUE_READ) {
+			result = _fram->readArray(start, group[0]->items, group[0]->values);
+		}
+		else {
+			result = _fram->writeArray(start, group[0]->items, group[0]->values);
+		}
+	}
+	else if (group[0]->op == FRAM_QUEUE_READ) {
+		result = _fram->readArray(start, (byte)span, _burst);
+		for (uint8_t k = 0; k < n; k++) {
+			memcpy(group[k]->values, &_burst[group[k]->framAddr - start], group[k]->items);
+		}
+	}
+	else {
+		for (uint8_t k = 0; k < n; k++) {
+			memcpy(&_burst[group[k]->framAddr - start], group[k]->values, group[k]->items);
+		}
+		result = _fram->writeArray(start, (byte)span, _burst);
+	}
+
+	for (uint8_t k = 0; k < n; k++) {
+		group[k]->result = result;
+		group[k]->done = true;
+	}
+}
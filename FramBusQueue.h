@@ -0,0 +1,64 @@
+/**************************************************************************/
+/*!
+    @file     FramBusQueue.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Request queue for FRAM shared between RTOS tasks.
+    Each task posts its read / write and blocks until done. The first task
+    getting the bus executes every queued request, merging adjacent small
+    reads (or writes) of different tasks into single bus transfers.
+    Relies on the bus lock of the chip (busLock()) - FRAM_THREAD_SAFE must be enabled.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_BUS_QUEUE_H_
+#define _FRAM_BUS_QUEUE_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// Maximum number of requests waiting for the bus
+#ifndef FRAM_QUEUE_DEPTH
+#define FRAM_QUEUE_DEPTH 8
+#endif
+
+#define FRAM_QUEUE_READ 0
+#define FRAM_QUEUE_WRITE 1
+
+typedef struct {
+	uint16_t	framAddr;
+	byte		items;
+	uint8_t		op;
+	uint8_t		*values;
+	volatile byte		result;
+	volatile boolean	done;
+} FramBusRequest;
+
+
+class FramBusQueue {
+ public:
+	FramBusQueue(FRAM_MB85RC_I2C *fram);
+
+	byte	readArray(uint16_t framAddr, byte items, uint8_t values[]);
+	byte	writeArray(uint16_t framAddr, byte items, uint8_t values[]);
+
+	uint32_t	requestCount(void);
+	uint32_t	transferCount(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	FramBusRequest	*_queue[FRAM_QUEUE_DEPTH];
+	uint8_t		_count;
+	uint8_t		_burst[FRAM_BURST_SIZE];
+	uint32_t	_requests;
+	uint32_t	_transfers;
+
+	byte	submit(FramBusRequest *req);
+	void	drain(void);
+	void	execute(FramBusRequest *group[], uint8_t n, uint16_t start, uint16_t span);
+};
+
+#endif
@@ -0,0 +1,469 @@
+/**************************************************************************/
+/*!
+    @file     FramRaid.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Composite device built from several FRAM_MB85RC_I2C chips.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramRaid.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] mode
+                FRAM_RAID_CONCAT, FRAM_RAID_STRIPE or FRAM_RAID_MIRROR
+    @params[in] members[]
+                Chips, each one begin() by the caller
+    @params[in] count
+                Number of chips, up to FRAM_RAID_MAX_MEMBERS
+    @params[in] memberSize
+                Bytes used on each chip, up to 65536
+    @params[in] stripeSize
+                Stripe size in bytes (FRAM_RAID_STRIPE only), memberSize must be a multiple of it
+*/
+/**************************************************************************/
+FramRaid::FramRaid(uint8_t mode, FRAM_MB85RC_I2C *members[], uint8_t count, uint32_t memberSize, uint16_t stripeSize)
+{
+	_mode = mode;
+	_count = (count > FRAM_RAID_MAX_MEMBERS) ? 0 : count;
+	_memberSize = memberSize;
+	_stripeSize = stripeSize;
+	_valid = (_count > 0) && (memberSize > 0) && (memberSize <= 0x10000UL) && (mode <= FRAM_RAID_MIRROR);
+	if ((mode == FRAM_RAID_STRIPE) && ((stripeSize == 0) || ((memberSize % stripeSize) != 0))) _valid = false;
+
+	for (uint8_t i = 0; i < FRAM_RAID_MAX_MEMBERS; i++) {
+		_members[i] = (i < _count) ? members[i] : NULL;
+		_healthy[i] = false;
+		_busyUs[i] = 0;
+	}
+	#if FRAM_RAID_WORKERS
+		_busCount = 0;
+		_parallel = false;
+		_jobLock = NULL;
+		for (uint8_t i = 0; i < FRAM_RAID_MAX_MEMBERS; i++) {
+			_workers[i].start = NULL;
+			_workers[i].done = NULL;
+		}
+	#endif
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Checks the chips. A mirror starts with the chips found, the others are rebuilt later.
+			A stripe on several controllers starts its workers (FRAM_RAID_WORKERS), transfers
+			are sequential if they cannot be started.
+
+    @returns
+				0: success
+				7: a chip is missing (concat / stripe) or every chip is missing (mirror)
+				10: invalid configuration
+*/
+/**************************************************************************/
+byte FramRaid::begin(void)
+{
+	if (!_valid) return ERROR_10;
+
+	uint8_t found = 0;
+	for (uint8_t i = 0; i < _count; i++) {
+		_healthy[i] = _members[i]->isReady();
+		if (_healthy[i]) found++;
+	}
+	#if FRAM_RAID_WORKERS
+		if (_mode == FRAM_RAID_STRIPE) FramRaid::startWorkers();
+	#endif
+	if (_mode == FRAM_RAID_MIRROR) return (found > 0) ? ERROR_0 : ERROR_7;
+	return (found == _count) ? ERROR_0 : ERROR_7;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads a block of any size, split on chip / stripe boundaries and in bursts
+
+    @params[in] framAddr
+                The 32-bit address to read from in the composite
+	@params[in] items
+				number of items to read
+	@params[out] values[]
+				array to be filled in by the memory read
+    @returns
+				0: success
+				8: number of bytes asked to read null
+				10: invalid configuration
+				11: range out of the composite
+				return code of FRAM_MB85RC_I2C::readBlock() of the first failing chip, in controller order with workers
+*/
+/**************************************************************************/
+byte FramRaid::readBlock(uint32_t framAddr, uint16_t items, uint8_t values[])
+{
+	if (!_valid) return ERROR_10;
+	if (items == 0) return ERROR_8;
+	if ((framAddr > FramRaid::size()) || (items > (FramRaid::size() - framAddr))) return ERROR_11;
+	#if FRAM_RAID_WORKERS
+		if (_parallel) return FramRaid::dispatch(false, framAddr, items, values);
+	#endif
+
+	byte result = ERROR_0;
+	uint16_t done = 0;
+	while ((done < items) && (result == ERROR_0)) {
+		uint8_t member;
+		uint16_t local;
+		uint16_t n = FramRaid::locate(framAddr + done, items - done, &member, &local);
+		if (_mode == FRAM_RAID_MIRROR) {
+			result = FramRaid::mirrorRead(local, n, &values[done]);
+		}
+		else {
+			result = FramRaid::timed(member, false, local, n, &values[done]);
+		}
+		done += n;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes a block of any size, split on chip / stripe boundaries and in bursts.
+			A mirror write succeeds while one chip at least takes it.
+
+    @params[in] framAddr
+                The 32-bit address to write to in the composite
+    @params[in] items
+                The number of items to write from the array
+	@params[in] values[]
+                The array of bytes to write
+    @returns
+				0: success
+				10: invalid configuration
+				11: range out of the composite
+				return code of FRAM_MB85RC_I2C::writeBlock() of the first failing chip, in controller order with workers
+*/
+/**************************************************************************/
+byte FramRaid::writeBlock(uint32_t framAddr, uint16_t items, uint8_t values[])
+{
+	if (!_valid) return ERROR_10;
+	if (items == 0) return ERROR_0;
+	if ((framAddr > FramRaid::size()) || (items > (FramRaid::size() - framAddr))) return ERROR_11;
+	#if FRAM_RAID_WORKERS
+		if (_parallel) return FramRaid::dispatch(true, framAddr, items, values);
+	#endif
+
+	byte result = ERROR_0;
+	uint16_t done = 0;
+	while ((done < items) && (result == ERROR_0)) {
+		uint8_t member;
+		uint16_t local;
+		uint16_t n = FramRaid::locate(framAddr + done, items - done, &member, &local);
+		if (_mode == FRAM_RAID_MIRROR) {
+			result = FramRaid::mirrorWrite(local, n, &values[done]);
+		}
+		else {
+			result = FramRaid::timed(member, true, local, n, &values[done]);
+		}
+		done += n;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a healthy mirror chip onto a replaced or recovered one, then puts it back in service.
+			Run it while the composite is idle, writes during the copy would only reach the healthy chips.
+
+    @params[in] member
+                Index of the chip to rebuild
+    @returns
+				0: success
+				7: the chip does not answer, or no healthy chip to copy from
+				10: not a mirror, or invalid member
+				return code of FRAM_MB85RC_I2C::readBlock() / writeBlock() on bus error
+*/
+/**************************************************************************/
+byte FramRaid::rebuild(uint8_t member)
+{
+	if (!_valid || (_mode != FRAM_RAID_MIRROR) || (member >= _count)) return ERROR_10;
+
+	uint8_t source = _count;
+	for (uint8_t i = 0; i < _count; i++) {
+		if ((i != member) && _healthy[i]) {
+			source = i;
+			break;
+		}
+	}
+	if (source == _count) return ERROR_7;
+
+	FRAM_MB85RC_I2C *target = _members[member];
+	if (!target->isReady() && (target->checkDevice() != ERROR_0)) return ERROR_7;
+
+	uint8_t buffer[FRAM_BURST_SIZE];
+	byte result = ERROR_0;
+	for (uint32_t addr = 0; (addr < _memberSize) && (result == ERROR_0); addr += FRAM_BURST_SIZE) {
+		byte n = ((_memberSize - addr) > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (byte)(_memberSize - addr);
+		result = _members[source]->readArray((uint16_t)addr, n, buffer);
+		if (result == ERROR_0) result = target->writeArray((uint16_t)addr, n, buffer);
+	}
+	if (result == ERROR_0) {
+		_healthy[member] = true;
+		_busyUs[member] = _busyUs[source];
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Size of the composite in bytes
+*/
+/**************************************************************************/
+uint32_t FramRaid::size(void)
+{
+	if (_mode == FRAM_RAID_MIRROR) return _memberSize;
+	return _memberSize * _count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether a chip is in service
+*/
+/**************************************************************************/
+boolean FramRaid::isHealthy(uint8_t member)
+{
+	return (member < _count) && _healthy[member];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of chips in service - below the chips count, a mirror runs degraded
+*/
+/**************************************************************************/
+uint8_t FramRaid::healthyCount(void)
+{
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < _count; i++) {
+		if (_healthy[i]) n++;
+	}
+	return n;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Maps a composite address to a chip & chip address
+
+    @returns
+				number of bytes contiguous on that chip, up to items
+*/
+/**************************************************************************/
+uint16_t FramRaid::locate(uint32_t framAddr, uint16_t items, uint8_t *member, uint16_t *local)
+{
+	uint32_t room;
+	switch (_mode) {
+		case FRAM_RAID_CONCAT:
+			*member = (uint8_t)(framAddr / _memberSize);
+			*local = (uint16_t)(framAddr % _memberSize);
+			room = _memberSize - (framAddr % _memberSize);
+			break;
+		case FRAM_RAID_STRIPE: {
+			uint32_t stripe = framAddr / _stripeSize;
+			uint16_t offset = (uint16_t)(framAddr % _stripeSize);
+			*member = (uint8_t)(stripe % _count);
+			*local = (uint16_t)((stripe / _count) * _stripeSize + offset);
+			room = _stripeSize - offset;
+			break;
+		}
+		default:
+			*member = 0;
+			*local = (uint16_t)framAddr;
+			room = _memberSize - framAddr;
+			break;
+	}
+	return (room < items) ? (uint16_t)room : items;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads from the healthy chip whose bus was the least busy, next one on chip failure
+*/
+/**************************************************************************/
+byte FramRaid::mirrorRead(uint16_t framAddr, uint16_t items, uint8_t values[])
+{
+	while (true) {
+		uint8_t best = _count;
+		for (uint8_t i = 0; i < _count; i++) {
+			if (_healthy[i] && ((best == _count) || (_busyUs[i] < _busyUs[best]))) best = i;
+		}
+		if (best == _count) return ERROR_7;
+
+		byte result = FramRaid::timed(best, false, framAddr, items, values);
+		if (!FramRaid::isChipFailure(result)) return result;
+		_healthy[best] = false;
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes to every healthy chip. A chip failing the write, whatever the error, is dropped :
+			its content is no longer a copy, rebuild() restores it.
+
+	@returns	  0 when a chip at least took the write, else the error of the first chip failing
+*/
+/**************************************************************************/
+byte FramRaid::mirrorWrite(uint16_t framAddr, uint16_t items, uint8_t values[])
+{
+	byte result = ERROR_7;
+	boolean taken = false;
+	for (uint8_t i = 0; i < _count; i++) {
+		if (!_healthy[i]) continue;
+		byte r = FramRaid::timed(i, true, framAddr, items, values);
+		if (r != ERROR_0) {
+			_healthy[i] = false;
+			if (result == ERROR_7) result = r;
+		}
+		else {
+			taken = true;
+		}
+	}
+	return taken ? ERROR_0 : result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Runs a transfer on a chip and accounts its bus time
+*/
+/**************************************************************************/
+byte FramRaid::timed(uint8_t member, boolean write, uint16_t framAddr, uint16_t items, uint8_t values[])
+{
+	FRAM_MB85RC_I2C *chip = _members[member];
+	if (!chip->isReady()) return ERROR_7;
+
+	uint32_t start = micros();
+	byte result = write ? chip->writeBlock(framAddr, items, values) : chip->readBlock(framAddr, items, values);
+	_busyUs[member] += micros() - start;
+
+	// keep the counters comparable, halved together before overflowing
+	if (_busyUs[member] & 0x80000000UL) {
+		for (uint8_t i = 0; i < _count; i++) _busyUs[i] >>= 1;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Errors meaning the chip itself is gone : address NACK or chip unidentified
+*/
+/**************************************************************************/
+boolean FramRaid::isChipFailure(byte result)
+{
+	return (result == ERROR_2) || (result == ERROR_7);
+}
+
+#if FRAM_RAID_WORKERS
+/**************************************************************************/
+/*!
+    @brief  Maps the chips to their controllers and starts one worker per controller but the first.
+			Runs once : the workers are never stopped.
+*/
+/**************************************************************************/
+void FramRaid::startWorkers(void)
+{
+	if (_busCount > 0) return;
+
+	TwoWire *wires[FRAM_RAID_MAX_MEMBERS];
+	for (uint8_t i = 0; i < _count; i++) {
+		TwoWire *wire = _members[i]->getWire();
+		uint8_t b = 0;
+		while ((b < _busCount) && (wires[b] != wire)) b++;
+		if (b == _busCount) wires[_busCount++] = wire;
+		_bus[i] = b;
+	}
+	if (_busCount < 2) return;
+
+	_jobLock = xSemaphoreCreateMutex();
+	boolean started = (_jobLock != NULL);
+	for (uint8_t b = 1; (b < _busCount) && started; b++) {
+		FramRaidWorker *w = &_workers[b];
+		w->raid = this;
+		w->bus = b;
+		w->start = xSemaphoreCreateBinary();
+		w->done = xSemaphoreCreateBinary();
+		started = (w->start != NULL) && (w->done != NULL)
+			&& (xTaskCreate(FramRaid::worker, "framRaid", FRAM_RAID_WORKER_STACK, w, uxTaskPriorityGet(NULL), NULL) == pdPASS);
+	}
+	_parallel = started;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Serves a transfer on every controller at once : the workers take theirs, the caller
+			the first one, then waits for the workers
+*/
+/**************************************************************************/
+byte FramRaid::dispatch(boolean write, uint32_t framAddr, uint16_t items, uint8_t values[])
+{
+	xSemaphoreTake(_jobLock, portMAX_DELAY);
+	_jobWrite = write;
+	_jobAddr = framAddr;
+	_jobItems = items;
+	_jobValues = values;
+	for (uint8_t b = 1; b < _busCount; b++) xSemaphoreGive(_workers[b].start);
+
+	byte result = FramRaid::serveBus(0);
+	for (uint8_t b = 1; b < _busCount; b++) {
+		xSemaphoreTake(_workers[b].done, portMAX_DELAY);
+		if (result == ERROR_0) result = _workers[b].result;
+	}
+	xSemaphoreGive(_jobLock);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Transfers the chunks of the current transfer held by the chips of one controller,
+			stops at the first failing one
+*/
+/**************************************************************************/
+byte FramRaid::serveBus(uint8_t bus)
+{
+	byte result = ERROR_0;
+	uint16_t done = 0;
+	while ((done < _jobItems) && (result == ERROR_0)) {
+		uint8_t member;
+		uint16_t local;
+		uint16_t n = FramRaid::locate(_jobAddr + done, _jobItems - done, &member, &local);
+		if (_bus[member] == bus) result = FramRaid::timed(member, _jobWrite, local, n, &_jobValues[done]);
+		done += n;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Worker task : serves its controller each time a transfer is dispatched
+*/
+/**************************************************************************/
+void FramRaid::worker(void *param)
+{
+	FramRaidWorker *w = (FramRaidWorker *)param;
+	while (true) {
+		xSemaphoreTake(w->start, portMAX_DELAY);
+		w->result = w->raid->serveBus(w->bus);
+		xSemaphoreGive(w->done);
+	}
+}
+#endif
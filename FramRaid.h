@@ -0,0 +1,126 @@
+/**************************************************************************/
+/*!
+    @file     FramRaid.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Composite device built from several FRAM_MB85RC_I2C chips of the same
+    size, on one or several I2C controllers (see setWire()). Addresses are
+    32-bit, the composite can be larger than 64 KB.
+
+      FRAM_RAID_CONCAT : chips one after the other, up to 8 chips at 0x50-0x57
+                         (not 4K / 16K parts, they use the address pins for paging)
+      FRAM_RAID_STRIPE : stripes of stripeSize bytes dealt round robin on the chips.
+                         With workers (FRAM_RAID_WORKERS), the chips of each
+                         controller are served by their own task.
+      FRAM_RAID_MIRROR : every chip holds the same data. Writes go to every chip,
+                         reads to the chip whose bus was the least busy so far.
+                         A chip answering ERROR_2 / ERROR_7 to a read, or failing
+                         a write, is dropped and the transfer goes on with the
+                         others, rebuild() restores it.
+
+    Arduino Wire transfers are blocking : transfers on two controllers overlap
+    only when issued from two tasks. With FRAM_THREAD_SAFE, each controller
+    has its own bus lock, a transfer on one does not wait for the other.
+    On ESP32, begin() of a stripe on several controllers starts one worker
+    task per controller but the first : a transfer is split per controller,
+    the caller serves the first one while the workers serve theirs, then
+    waits for them. The workers run for the lifetime of the program, keep
+    the composite global. Do not call it while holding a bus lock.
+    Without workers, the chunks are transferred one after the other :
+    striping adds capacity, not throughput.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_RAID_H_
+#define _FRAM_RAID_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+#define FRAM_RAID_MAX_MEMBERS 8
+
+// Worker tasks transferring the stripes of each controller concurrently - FreeRTOS only (ESP32)
+#ifndef FRAM_RAID_WORKERS
+ #if FRAM_THREAD_SAFE && (defined(ESP32) || defined(ESP_PLATFORM))
+  #define FRAM_RAID_WORKERS 1
+ #else
+  #define FRAM_RAID_WORKERS 0
+ #endif
+#endif
+#ifndef FRAM_RAID_WORKER_STACK
+#define FRAM_RAID_WORKER_STACK 2048		// bytes
+#endif
+
+#if FRAM_RAID_WORKERS
+ #include <freertos/FreeRTOS.h>
+ #include <freertos/semphr.h>
+ #include <freertos/task.h>
+#endif
+
+#define FRAM_RAID_CONCAT 0
+#define FRAM_RAID_STRIPE 1
+#define FRAM_RAID_MIRROR 2
+
+class FramRaid;
+
+#if FRAM_RAID_WORKERS
+typedef struct {
+	FramRaid	*raid;
+	uint8_t		bus;
+	byte		result;
+	SemaphoreHandle_t	start;		// given by the caller, a transfer to serve
+	SemaphoreHandle_t	done;		// given by the worker, its part served
+} FramRaidWorker;
+#endif
+
+class FramRaid {
+ public:
+	FramRaid(uint8_t mode, FRAM_MB85RC_I2C *members[], uint8_t count, uint32_t memberSize, uint16_t stripeSize = FRAM_BURST_SIZE);
+
+	byte	begin(void);
+	byte	readBlock(uint32_t framAddr, uint16_t items, uint8_t values[]);
+	byte	writeBlock(uint32_t framAddr, uint16_t items, uint8_t values[]);
+	byte	rebuild(uint8_t member);
+
+	uint32_t	size(void);
+	boolean		isHealthy(uint8_t member);
+	uint8_t		healthyCount(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_members[FRAM_RAID_MAX_MEMBERS];
+	uint8_t		_count;
+	uint8_t		_mode;
+	uint32_t	_memberSize;
+	uint16_t	_stripeSize;
+	boolean		_valid;
+	boolean		_healthy[FRAM_RAID_MAX_MEMBERS];
+	uint32_t	_busyUs[FRAM_RAID_MAX_MEMBERS];	// bus time spent by each chip, for read balancing
+#if FRAM_RAID_WORKERS
+	uint8_t		_bus[FRAM_RAID_MAX_MEMBERS];	// controller of each chip, in order of first appearance
+	uint8_t		_busCount;
+	boolean		_parallel;		// every worker started
+	SemaphoreHandle_t	_jobLock;	// one striped transfer at a time
+	FramRaidWorker	_workers[FRAM_RAID_MAX_MEMBERS];	// one per controller but the first
+	boolean		_jobWrite;		// transfer being served
+	uint32_t	_jobAddr;
+	uint16_t	_jobItems;
+	uint8_t		*_jobValues;
+#endif
+
+	uint16_t	locate(uint32_t framAddr, uint16_t items, uint8_t *member, uint16_t *local);
+	byte		mirrorRead(uint16_t framAddr, uint16_t items, uint8_t values[]);
+	byte		mirrorWrite(uint16_t framAddr, uint16_t items, uint8_t values[]);
+	byte		timed(uint8_t member, boolean write, uint16_t framAddr, uint16_t items, uint8_t values[]);
+	static boolean	isChipFailure(byte result);
+#if FRAM_RAID_WORKERS
+	void		startWorkers(void);
+	byte		dispatch(boolean write, uint32_t framAddr, uint16_t items, uint8_t values[]);
+	byte		serveBus(uint8_t bus);
+	static void	worker(void *param);
+#endif
+};
+
+#endif
@@ -0,0 +1,687 @@
+/**************************************************************************/
+/*!
+    @file     FramRecordStore.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Variable length record store on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramRecordStore.h"
+
+static uint16_t toGray(uint16_t n)
+{
+	return n ^ (n >> 1);
+}
+
+static uint16_t fromGray(uint16_t g)
+{
+	for (uint8_t shift = 1; shift < 16; shift <<= 1) g ^= g >> shift;
+	return g;
+}
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the store lives on
+    @params[in] baseAddr
+                First address of the store region
+    @params[in] size
+                Size of the region, header included
+*/
+/**************************************************************************/
+FramRecordStore::FramRecordStore(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_end = (uint32_t)baseAddr + size;
+	_valid = (size >= (FRAM_RS_HEADER_SIZE + 2 * FRAM_RS_RECORD_HEADER)) && (_end <= 0x10000UL);
+	_ready = false;
+	FramRecordStore::clearIndex();
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Rebuilds the RAM index with one sequential scan of the log, after completing
+			a move interrupted by a reset. An update interrupted before killing the old copy
+			keeps the new one.
+
+    @returns
+				0: success
+				10: region too small or out of the 64K memory map
+				12: region not formatted, or record IDs above FRAM_RS_MAX_RECORDS - call format()
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::begin(void)
+{
+	_ready = false;
+	FramRecordStore::clearIndex();
+	if (!_valid) return ERROR_10;
+
+	FramRSHeader header;
+	byte result = _fram->readArray(_base, sizeof(header), (uint8_t *)&header);
+	if (result != ERROR_0) return result;
+	if (header.signature != FRAM_RS_SIGNATURE) return ERROR_12;
+
+	if (header.state == FRAM_RS_MOVING) {
+		// the log is not walkable across a move in progress : complete it first
+		if (((uint32_t)header.dst + FRAM_RS_RECORD_HEADER > header.src) || ((uint32_t)header.src + header.length > _end)) return ERROR_12;
+		if ((header.chunk == 0) || (header.chunk > (header.src - header.dst))) return ERROR_12;
+		_move = header;
+		_move.progress = fromGray(header.progress);
+		result = FramRecordStore::finishMove();
+		if (result != ERROR_0) return result;
+	}
+
+	result = FramRecordStore::scan();
+	_ready = (result == ERROR_0);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Empties the store : writes the header & an empty log
+
+    @returns
+				0: success
+				10: region too small or out of the 64K memory map
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::format(void)
+{
+	_ready = false;
+	FramRecordStore::clearIndex();
+	if (!_valid) return ERROR_10;
+
+	uint8_t buffer[FRAM_RS_HEADER_SIZE + 2];
+	FramRSHeader header = { FRAM_RS_SIGNATURE, 0, 0, 0, 0, 0, 0 };
+	uint16_t end = FRAM_RS_END;
+	memcpy(buffer, &header, FRAM_RS_HEADER_SIZE);
+	memcpy(&buffer[FRAM_RS_HEADER_SIZE], &end, sizeof(end));
+
+	byte result = _fram->writeArray(_base, sizeof(buffer), buffer);
+	_ready = (result == ERROR_0);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Appends a record. When the end of the log has no room left but tombstones
+			would give it, the compaction is completed first.
+
+    @params[in] data[]
+                Record payload
+    @params[in] length
+                Payload length, 0 allowed
+    @params[out] id
+                ID given to the record
+    @returns
+				0: success
+				10: store not ready - begin() or format() first
+				11: no free ID, or no room left
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::append(const uint8_t data[], uint16_t length, uint16_t *id)
+{
+	if (!_ready) return ERROR_10;
+	if (length > FRAM_RS_LENGTH_MAX) return ERROR_11;
+
+	uint16_t slot = 0;
+	while ((slot < FRAM_RS_MAX_RECORDS) && (_addr[slot] != FRAM_RS_NONE)) slot++;
+	if (slot == FRAM_RS_MAX_RECORDS) return ERROR_11;
+
+	byte result;
+	if (!FramRecordStore::fits(length)) {
+		if (((uint32_t)length + 2 * FRAM_RS_RECORD_HEADER) > ((_end - _tail) + _dead)) return ERROR_11;
+		result = FramRecordStore::compact();
+		if (result != ERROR_0) return result;
+		if (!FramRecordStore::fits(length)) return ERROR_11;
+	}
+
+	result = FramRecordStore::writeRecord(slot, data, length);
+	if (result == ERROR_0) {
+		*id = slot;
+		_count++;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replaces a record : the new copy is appended, then the old one is killed
+
+    @params[in] id
+                Record ID
+    @params[in] data[]
+                New payload
+    @params[in] length
+                New payload length
+    @returns
+				0: success
+				10: store not ready
+				11: no such record, or no room left
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::update(uint16_t id, const uint8_t data[], uint16_t length)
+{
+	if (!_ready) return ERROR_10;
+	if (!FramRecordStore::exists(id) || (length > FRAM_RS_LENGTH_MAX)) return ERROR_11;
+
+	byte result;
+	if (FramRecordStore::moving() && (id == _moveId)) {
+		result = FramRecordStore::finishMove();
+		if (result != ERROR_0) return result;
+	}
+	if (!FramRecordStore::fits(length)) {
+		if (((uint32_t)length + 2 * FRAM_RS_RECORD_HEADER) > ((_end - _tail) + _dead)) return ERROR_11;
+		result = FramRecordStore::compact();
+		if (result != ERROR_0) return result;
+		if (!FramRecordStore::fits(length)) return ERROR_11;
+	}
+
+	uint16_t old = _addr[id];
+	uint16_t oldLength = _length[id];
+	result = FramRecordStore::writeRecord(id, data, length);
+	if (result != ERROR_0) return result;
+
+	result = _fram->writeByte(old + 3, FRAM_RS_MARK);
+	if (result == ERROR_0) FramRecordStore::noteDead(old, FRAM_RS_RECORD_HEADER + oldLength);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads a record by ID - a single transfer up to FRAM_BURST_SIZE bytes
+
+    @params[in] id
+                Record ID
+    @params[out] data[]
+                Buffer receiving the payload
+    @params[in] maxLength
+                Buffer size
+    @params[out] length
+                Payload length, set when the buffer is too small too
+    @returns
+				0: success
+				1: buffer too small, nothing read
+				10: store not ready
+				11: no such record
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::read(uint16_t id, uint8_t data[], uint16_t maxLength, uint16_t *length)
+{
+	if (!_ready) return ERROR_10;
+	if (!FramRecordStore::exists(id)) return ERROR_11;
+
+	if (FramRecordStore::moving() && (id == _moveId)) {
+		byte result = FramRecordStore::finishMove();
+		if (result != ERROR_0) return result;
+	}
+
+	*length = _length[id];
+	if (_length[id] > maxLength) return ERROR_1;
+	if (_length[id] == 0) return ERROR_0;
+	return _fram->readBlock(_addr[id] + FRAM_RS_RECORD_HEADER, _length[id], data);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Deletes a record : its ID becomes a tombstone, the room is reclaimed by compaction
+
+    @params[in] id
+                Record ID
+    @returns
+				0: success
+				10: store not ready
+				11: no such record
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::remove(uint16_t id)
+{
+	if (!_ready) return ERROR_10;
+	if (!FramRecordStore::exists(id)) return ERROR_11;
+
+	byte result;
+	if (FramRecordStore::moving() && (id == _moveId)) {
+		result = FramRecordStore::finishMove();
+		if (result != ERROR_0) return result;
+	}
+	result = FramRecordStore::kill(id);
+	if (result == ERROR_0) _count--;
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compaction step, call it from loop(). A compaction starts once FRAM_RS_COMPACT_MIN
+			dead bytes are found, from the lowest run of FRAM_BURST_SIZE contiguous dead bytes
+			or the dead bytes ending the log. Each call then moves one chunk of FRAM_BURST_SIZE
+			bytes, or closes a move, or ends the log after the last live record.
+
+    @returns
+				0: success, or nothing to do
+				10: store not ready
+				return code of Wire.endTransmission() on bus error - the step is retried on the next call
+*/
+/**************************************************************************/
+byte FramRecordStore::poll(void)
+{
+	if (!_ready) return ERROR_10;
+	if (FramRecordStore::moving()) return FramRecordStore::moveChunk();
+	if (!_compacting) {
+		if ((_dead < FRAM_RS_COMPACT_MIN) || (_firstDead == FRAM_RS_NONE) || !_runSearch) return ERROR_0;
+		uint16_t from = FramRecordStore::deadRun();
+		if (from == FRAM_RS_NONE) {
+			_runSearch = false;		// until more records die
+			return ERROR_0;
+		}
+		FramRecordStore::startCompaction(from);
+	}
+	return FramRecordStore::step();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Runs the compaction to its end, whatever the dead bytes amount. Dead runs
+			shorter than a burst are swept too, by chunks as short as them.
+
+    @returns
+				0: success
+				10: store not ready
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramRecordStore::compact(void)
+{
+	if (!_ready) return ERROR_10;
+	while (_compacting || FramRecordStore::moving() || (_firstDead != FRAM_RS_NONE)) {
+		byte result;
+		if (FramRecordStore::moving()) {
+			result = FramRecordStore::moveChunk();
+		}
+		else {
+			if (!_compacting) FramRecordStore::startCompaction(_firstDead);
+			result = FramRecordStore::step();
+		}
+		if (result != ERROR_0) return result;
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether a record exists
+*/
+/**************************************************************************/
+boolean FramRecordStore::exists(uint16_t id)
+{
+	return (id < FRAM_RS_MAX_RECORDS) && (_addr[id] != FRAM_RS_NONE);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Payload length of a record, 0 if it does not exist
+*/
+/**************************************************************************/
+uint16_t FramRecordStore::length(uint16_t id)
+{
+	return FramRecordStore::exists(id) ? _length[id] : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of records
+*/
+/**************************************************************************/
+uint16_t FramRecordStore::count(void)
+{
+	return _count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Largest payload an append() could take, dead bytes included
+*/
+/**************************************************************************/
+uint16_t FramRecordStore::freeBytes(void)
+{
+	uint32_t room = (_end - _tail) + _dead;
+	if (room <= 2 * FRAM_RS_RECORD_HEADER) return 0;
+	room -= 2 * FRAM_RS_RECORD_HEADER;
+	return (room > 0xFFFE) ? 0xFFFE : (uint16_t)room;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Bytes held by tombstones & compaction fillers, headers included
+*/
+/**************************************************************************/
+uint16_t FramRecordStore::deadBytes(void)
+{
+	return _dead;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether a compaction is in progress
+*/
+/**************************************************************************/
+boolean FramRecordStore::compacting(void)
+{
+	return _compacting || FramRecordStore::moving();
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Empties the RAM index & compaction state
+*/
+/**************************************************************************/
+void FramRecordStore::clearIndex(void)
+{
+	for (uint16_t i = 0; i < FRAM_RS_MAX_RECORDS; i++) _addr[i] = FRAM_RS_NONE;
+	_count = 0;
+	_tail = _base + FRAM_RS_HEADER_SIZE;
+	_dead = 0;
+	_firstDead = FRAM_RS_NONE;
+	_runSearch = true;
+	_compacting = false;
+	_dst = 0;
+	_src = 0;
+	memset(&_move, 0, sizeof(_move));
+	_moveId = FRAM_RS_NONE;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Walks the log from its start to the end marker and fills the RAM index.
+			Headers are read through a burst sized window : small records cost a
+			transfer for several of them, large ones a transfer each.
+*/
+/**************************************************************************/
+byte FramRecordStore::scan(void)
+{
+	uint8_t window[FRAM_BURST_SIZE];
+	uint16_t winAddr = 0;
+	uint16_t winLen = 0;
+	uint32_t at = _base + FRAM_RS_HEADER_SIZE;
+	byte result;
+
+	while (true) {
+		if ((at + FRAM_RS_RECORD_HEADER) > _end) return ERROR_12;	// no end marker
+		if ((at < winAddr) || ((at + FRAM_RS_RECORD_HEADER) > ((uint32_t)winAddr + winLen))) {
+			winAddr = (uint16_t)at;
+			winLen = ((_end - at) > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (uint16_t)(_end - at);
+			result = _fram->readArray(winAddr, (byte)winLen, window);
+			if (result != ERROR_0) return result;
+		}
+
+		FramRSRecord record;
+		memcpy(&record, &window[at - winAddr], sizeof(record));
+		if ((record.length >> 8) == FRAM_RS_MARK) break;
+		if ((at + 2 * FRAM_RS_RECORD_HEADER + record.length) > _end) {
+			// damaged length : the log ends here
+			result = _fram->writeByte((uint16_t)at + 1, FRAM_RS_MARK);
+			if (result != ERROR_0) return result;
+			break;
+		}
+
+		uint16_t bytes = FRAM_RS_RECORD_HEADER + record.length;
+		if ((record.id >> 8) == FRAM_RS_MARK) {
+			FramRecordStore::noteDead((uint16_t)at, bytes);
+		}
+		else if (record.id >= FRAM_RS_MAX_RECORDS) {
+			return ERROR_12;
+		}
+		else {
+			if (_addr[record.id] != FRAM_RS_NONE) {
+				// update interrupted before the old copy was killed : the later copy wins
+				result = FramRecordStore::kill(record.id);
+				if (result != ERROR_0) return result;
+			}
+			else {
+				_count++;
+			}
+			_addr[record.id] = (uint16_t)at;
+			_length[record.id] = record.length;
+		}
+		at += bytes;
+	}
+	_tail = (uint16_t)at;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes a record at the end of the log. The ID, payload & new end marker go
+			first - in one transfer when they fit a burst - the length commits the record.
+*/
+/**************************************************************************/
+byte FramRecordStore::writeRecord(uint16_t id, const uint8_t data[], uint16_t length)
+{
+	uint16_t at = _tail;
+	uint16_t end = FRAM_RS_END;
+	byte result;
+
+	if (((uint32_t)length + FRAM_RS_RECORD_HEADER) <= FRAM_BURST_SIZE) {
+		uint8_t buffer[FRAM_BURST_SIZE];
+		memcpy(buffer, &id, sizeof(id));
+		memcpy(&buffer[2], data, length);
+		memcpy(&buffer[2 + length], &end, sizeof(end));
+		result = _fram->writeArray(at + 2, (byte)(length + 4), buffer);
+	}
+	else {
+		result = _fram->writeWord(at + 2, id);
+		if (result == ERROR_0) result = _fram->writeBlock(at + FRAM_RS_RECORD_HEADER, length, (uint8_t *)data);
+		if (result == ERROR_0) result = _fram->writeWord(at + FRAM_RS_RECORD_HEADER + length, end);
+	}
+	if (result == ERROR_0) result = _fram->writeWord(at, length);
+	if (result != ERROR_0) return result;
+
+	_tail = at + FRAM_RS_RECORD_HEADER + length;
+	_addr[id] = at;
+	_length[id] = length;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Turns a record into a tombstone & drops it from the index
+*/
+/**************************************************************************/
+byte FramRecordStore::kill(uint16_t id)
+{
+	uint16_t at = _addr[id];
+	byte result = _fram->writeByte(at + 3, FRAM_RS_MARK);
+	if (result != ERROR_0) return result;
+
+	FramRecordStore::noteDead(at, FRAM_RS_RECORD_HEADER + _length[id]);
+	_addr[id] = FRAM_RS_NONE;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Accounts a dead record. Those above the compaction front are swept by the
+			current compaction, the lowest one below starts the next.
+*/
+/**************************************************************************/
+void FramRecordStore::noteDead(uint16_t framAddr, uint16_t bytes)
+{
+	_dead += bytes;
+	_runSearch = true;
+	if (_compacting && (framAddr >= _dst)) return;
+	if ((_firstDead == FRAM_RS_NONE) || (framAddr < _firstDead)) _firstDead = framAddr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  ID of the live record with the lowest address at or after framAddr, FRAM_RS_NONE if none
+*/
+/**************************************************************************/
+uint16_t FramRecordStore::nextLive(uint16_t framAddr)
+{
+	uint16_t best = FRAM_RS_NONE;
+	for (uint16_t i = 0; i < FRAM_RS_MAX_RECORDS; i++) {
+		if ((_addr[i] == FRAM_RS_NONE) || (_addr[i] < framAddr)) continue;
+		if ((best == FRAM_RS_NONE) || (_addr[i] < _addr[best])) best = i;
+	}
+	return best;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Address of the lowest run of at least FRAM_BURST_SIZE dead bytes, or of the dead
+			bytes ending the log, FRAM_RS_NONE if none. The log is live up to the lowest dead record.
+*/
+/**************************************************************************/
+uint16_t FramRecordStore::deadRun(void)
+{
+	uint16_t from = _firstDead;		// end of a live record
+	while (true) {
+		uint16_t id = FramRecordStore::nextLive(from);
+		uint16_t next = (id == FRAM_RS_NONE) ? _tail : _addr[id];
+		if ((next - from) >= FRAM_BURST_SIZE) return from;
+		if (id == FRAM_RS_NONE) return (next > from) ? from : FRAM_RS_NONE;
+		from = _addr[id] + FRAM_RS_RECORD_HEADER + _length[id];
+	}
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts a compaction from a dead record, the dead records below it are kept for the next one
+*/
+/**************************************************************************/
+void FramRecordStore::startCompaction(uint16_t framAddr)
+{
+	_compacting = true;
+	_dst = framAddr;
+	_src = framAddr;
+	if (_firstDead == framAddr) _firstDead = FRAM_RS_NONE;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Next compaction step : journals the move of the next live record & moves its first
+			chunk, or ends the log at the compaction front once no live record is left above
+*/
+/**************************************************************************/
+byte FramRecordStore::step(void)
+{
+	uint16_t id = FramRecordStore::nextLive(_src);
+	if (id == FRAM_RS_NONE) {
+		byte result = _fram->writeByte(_dst + 1, FRAM_RS_MARK);
+		if (result == ERROR_0) {
+			_dead -= (_tail - _dst);
+			_tail = _dst;
+			_compacting = false;
+		}
+		return result;
+	}
+
+	uint16_t gap = _addr[id] - _dst;
+	_move.src = _addr[id];
+	_move.dst = _dst;
+	_move.length = FRAM_RS_RECORD_HEADER + _length[id];
+	_move.progress = 0;
+	_move.chunk = (gap > FRAM_BURST_SIZE) ? FRAM_BURST_SIZE : (uint8_t)gap;
+	_move.state = FRAM_RS_MOVING;
+	byte result = _fram->writeArray(_base + 2, FRAM_RS_HEADER_SIZE - 2, (uint8_t *)&_move.src);	// state byte last
+	if (result != ERROR_0) {
+		_move.state = 0;
+		return result;
+	}
+	_moveId = id;
+	return FramRecordStore::moveChunk();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies one chunk of the record being moved, or closes the move once copied : the
+			rest of the old copy becomes a filler record, then the journal is cleared.
+			Chunks never exceed the distance between both copies, so a chunk never overwrites
+			source bytes not copied yet. When the new copy or the filler overlaps the old copy,
+			the progress is saved after each chunk and a resume never reads bytes already
+			overwritten. Otherwise a resume copies the record again from its start.
+*/
+/**************************************************************************/
+byte FramRecordStore::moveChunk(void)
+{
+	uint16_t gap = _move.src - _move.dst;
+	uint32_t done = (uint32_t)_move.progress * _move.chunk;
+	byte result;
+
+	if (done < _move.length) {
+		uint16_t n = ((_move.length - done) > _move.chunk) ? _move.chunk : (uint16_t)(_move.length - done);
+
+		uint8_t buffer[FRAM_BURST_SIZE];
+		result = _fram->readArray(_move.src + done, (byte)n, buffer);
+		if (result == ERROR_0) result = _fram->writeArray(_move.dst + done, (byte)n, buffer);
+		if ((result == ERROR_0) && (gap < (_move.length + FRAM_RS_RECORD_HEADER))) {
+			result = _fram->writeWord(_base + 8, toGray(_move.progress + 1));
+		}
+		if (result == ERROR_0) _move.progress++;
+		return result;
+	}
+
+	FramRSRecord filler = { (uint16_t)(gap - FRAM_RS_RECORD_HEADER), FRAM_RS_DEAD };
+	result = _fram->writeArray(_move.dst + _move.length, sizeof(filler), (uint8_t *)&filler);
+	if (result == ERROR_0) result = _fram->writeByte(_base + 11, 0);
+	if (result != ERROR_0) return result;
+
+	if (_moveId != FRAM_RS_NONE) _addr[_moveId] = _move.dst;
+	_dst = _move.dst + _move.length;
+	_src = _move.src + _move.length;
+	_move.state = 0;
+	_moveId = FRAM_RS_NONE;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Runs the move in progress to its end
+*/
+/**************************************************************************/
+byte FramRecordStore::finishMove(void)
+{
+	while (FramRecordStore::moving()) {
+		byte result = FramRecordStore::moveChunk();
+		if (result != ERROR_0) return result;
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether a payload fits between the end of the log and the end of the region,
+			room kept for the end marker
+*/
+/**************************************************************************/
+boolean FramRecordStore::fits(uint16_t length)
+{
+	return ((uint32_t)_tail + 2 * FRAM_RS_RECORD_HEADER + length) <= _end;
+}
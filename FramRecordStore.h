@@ -0,0 +1,153 @@
+/**************************************************************************/
+/*!
+    @file     FramRecordStore.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Variable length record store on top of FRAM_MB85RC_I2C. Records are
+    appended to a log, each one prefixed with its length & ID. A RAM index
+    keeps the address & length of every record : begin() rebuilds it with
+    one sequential scan, and a record fitting a burst is read by ID in a
+    single transfer.
+
+    remove() and update() turn the old copy into a tombstone. poll() then
+    compacts the log in place : live records slide down over the dead ones,
+    one burst sized chunk per call. A chunk cannot be longer than the dead
+    run the records slide over, so poll() starts from the lowest run of at
+    least FRAM_BURST_SIZE dead bytes, smaller runs below are left to
+    compact() or to a later pass once their neighbours die. A record being
+    moved is journaled in the region header, begin() completes a move
+    interrupted by a reset.
+
+    FRAM layout of a store region :
+      [0..1]   signature
+      [2..11]  move journal : source (2) - destination (2) - length (2) -
+               chunks copied (2, Gray code) - chunk size (1) - state (1)
+      [12..]   records, then the end of log marker
+
+    Record layout :
+      [0..1]   payload length - high byte 0xFF : end of log
+      [2..3]   record ID - high byte 0xFF : tombstone or filler left by compaction
+      [4..]    payload
+
+    Every commit point is a single byte, or a word of which a single byte
+    changes : an append writes its length last over the end marker, a
+    tombstone or a new end of log is the 0xFF high byte, the journal state
+    byte is written after the journal, the chunks count is a Gray code. A
+    reset in the middle of any transfer loses at most the operation running.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_RECORD_STORE_H_
+#define _FRAM_RECORD_STORE_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// RAM budget : record IDs (4 bytes of index each)
+#ifndef FRAM_RS_MAX_RECORDS
+ #if defined(ARDUINO_ARCH_AVR)
+  #define FRAM_RS_MAX_RECORDS 32
+ #else
+  #define FRAM_RS_MAX_RECORDS 256
+ #endif
+#endif
+
+// Dead bytes starting a compaction from poll(), once FRAM_BURST_SIZE of them are contiguous
+#ifndef FRAM_RS_COMPACT_MIN
+#define FRAM_RS_COMPACT_MIN 32
+#endif
+
+#define FRAM_RS_SIGNATURE 0x5253
+#define FRAM_RS_HEADER_SIZE 12
+#define FRAM_RS_RECORD_HEADER 4
+#define FRAM_RS_MARK 0xFF			// high byte of end of log lengths & dead IDs
+#define FRAM_RS_END 0xFFFF
+#define FRAM_RS_DEAD 0xFFFF
+#define FRAM_RS_LENGTH_MAX 0xFEFF
+#define FRAM_RS_MOVING 0xA5
+#define FRAM_RS_NONE 0xFFFF
+
+typedef struct {
+	uint16_t	length;
+	uint16_t	id;
+} FramRSRecord;
+
+typedef struct {
+	uint16_t	signature;
+	uint16_t	src;
+	uint16_t	dst;
+	uint16_t	length;
+	uint16_t	progress;	// chunks copied - Gray code in FRAM, binary in RAM
+	uint8_t		chunk;
+	uint8_t		state;		// FRAM_RS_MOVING, 0 when idle
+} FramRSHeader;
+
+
+class FramRecordStore {
+ public:
+	FramRecordStore(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size);
+
+	byte	begin(void);
+	byte	format(void);
+	byte	append(const uint8_t data[], uint16_t length, uint16_t *id);
+	byte	update(uint16_t id, const uint8_t data[], uint16_t length);
+	byte	read(uint16_t id, uint8_t data[], uint16_t maxLength, uint16_t *length);
+	byte	remove(uint16_t id);
+	byte	poll(void);
+	byte	compact(void);
+
+	boolean		exists(uint16_t id);
+	uint16_t	length(uint16_t id);
+	uint16_t	count(void);
+	uint16_t	freeBytes(void);
+	uint16_t	deadBytes(void);
+	boolean		compacting(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint32_t	_end;
+	boolean		_valid;
+	boolean		_ready;
+
+	// RAM index, by record ID
+	uint16_t	_addr[FRAM_RS_MAX_RECORDS];		// record header address, FRAM_RS_NONE when free
+	uint16_t	_length[FRAM_RS_MAX_RECORDS];
+
+	uint16_t	_count;
+	uint16_t	_tail;			// end of log marker address
+	uint16_t	_dead;			// tombstones & fillers bytes, headers included
+	uint16_t	_firstDead;		// lowest dead record not swept by the current compaction
+	boolean		_runSearch;		// dead records noted since poll() last looked for a dead run
+
+	// compaction : records below _dst are compacted, the next one to move is the first live at or after _src
+	boolean		_compacting;
+	uint16_t	_dst;
+	uint16_t	_src;
+	FramRSHeader	_move;		// journal mirror
+	uint16_t	_moveId;
+
+#if __cplusplus >= 201103L
+	static_assert(FRAM_RS_MAX_RECORDS < (FRAM_RS_MARK << 8), "FRAM_RS_MAX_RECORDS collides with dead IDs");
+	static_assert(sizeof(FramRSHeader) == FRAM_RS_HEADER_SIZE, "FramRSHeader not packed as laid out in FRAM");
+#endif
+
+	void		clearIndex(void);
+	byte		scan(void);
+	byte		writeRecord(uint16_t id, const uint8_t data[], uint16_t length);
+	byte		kill(uint16_t id);
+	void		noteDead(uint16_t framAddr, uint16_t bytes);
+	uint16_t	nextLive(uint16_t framAddr);
+	uint16_t	deadRun(void);
+	void		startCompaction(uint16_t framAddr);
+	byte		step(void);
+	byte		moveChunk(void);
+	byte		finishMove(void);
+	boolean		fits(uint16_t length);
+	boolean		moving(void) { return _move.state == FRAM_RS_MOVING; }
+};
+
+#endif
@@ -0,0 +1,466 @@
+/**************************************************************************/
+/*!
+    @file     FramScrubber.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Incremental background integrity scrubber on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramScrubber.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the regions live on
+    @params[in] onError
+                Called with the address & size of each block failing its CRC, may be NULL
+*/
+/**************************************************************************/
+FramScrubber::FramScrubber(FRAM_MB85RC_I2C *fram, void (*onError)(uint16_t framAddr, uint16_t items))
+{
+	_fram = fram;
+	_onError = onError;
+	_regionCount = 0;
+	_region = 0;
+	_block = 0;
+	_offset = 0;
+	_crc = 0xFFFF;
+	_persist = false;
+	_cursorAddr = 0;
+	_sinceSave = 0;
+	_cost = 0;
+	_costDev = 0;
+	_costFloor = 0;
+	_windowMin = 0xFFFFFFFFUL;
+	_windowCount = 0;
+	_measured = false;
+	_decayed = false;
+	_passes = 0;
+	_errors = 0;
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Registers a region to scrub. The first one registered times a 1 byte read of the region,
+			the first estimate of the cost of a byte - a bus error is not reported, poll() retries.
+
+    @params[in] framAddr
+                First address of the region
+    @params[in] size
+                Size of the region in bytes, the last block may be shorter
+    @params[in] blockSize
+                Bytes covered by one CRC
+    @params[in] crcAddr
+                First address of the CRC table, 2 bytes per block, outside the region
+    @returns
+				0: success
+				10: table full (FRAM_SCRUB_MAX_REGIONS) or null size
+				11: region or CRC table out of the 16-bit address space
+*/
+/**************************************************************************/
+byte FramScrubber::addRegion(uint16_t framAddr, uint16_t size, uint8_t blockSize, uint16_t crcAddr)
+{
+	if ((_regionCount >= FRAM_SCRUB_MAX_REGIONS) || (size == 0) || (blockSize == 0)) return ERROR_10;
+	if (((uint32_t)framAddr + size) > 0x10000UL) return ERROR_11;
+
+	FramScrubRegion *r = &_regions[_regionCount];
+	r->framAddr = framAddr;
+	r->size = size;
+	r->crcAddr = crcAddr;
+	r->blockSize = blockSize;
+	if (((uint32_t)crcAddr + 2UL * FramScrubber::blockCount(_regionCount)) > 0x10000UL) return ERROR_11;
+
+	_regionCount++;
+	if (!_measured) FramScrubber::probe(framAddr);
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Computes and stores the CRC of every block of a region - the region content is taken as good
+
+    @params[in] regionNb
+                Index of the region, in addRegion() order
+    @returns
+				0: success
+				11: no such region
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramScrubber::seal(uint8_t regionNb)
+{
+	if (regionNb >= _regionCount) return ERROR_11;
+
+	uint16_t blocks = FramScrubber::blockCount(regionNb);
+	for (uint16_t b = 0; b < blocks; b++) {
+		byte result = FramScrubber::sealBlock(regionNb, b);
+		if (result != ERROR_0) return result;
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Updates the CRC of the blocks overlapping a range, to be called after writing into a region
+
+    @params[in] framAddr
+                First address written
+    @params[in] items
+                Number of bytes written
+    @returns
+				0: success (also when the range is not protected)
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramScrubber::sealRange(uint16_t framAddr, uint16_t items)
+{
+	if (items == 0) return ERROR_0;
+	uint32_t end = (uint32_t)framAddr + items;
+
+	for (uint8_t i = 0; i < _regionCount; i++) {
+		FramScrubRegion *r = &_regions[i];
+		uint32_t rEnd = (uint32_t)r->framAddr + r->size;
+		if ((end <= r->framAddr) || (framAddr >= rEnd)) continue;
+
+		uint16_t first = (framAddr > r->framAddr) ? (framAddr - r->framAddr) / r->blockSize : 0;
+		uint16_t last = (uint16_t)(((end < rEnd ? end : rEnd) - 1 - r->framAddr) / r->blockSize);
+		for (uint16_t b = first; b <= last; b++) {
+			byte result = FramScrubber::sealBlock(i, b);
+			if (result != ERROR_0) return result;
+			// the partial CRC of the block being scrubbed no longer applies
+			if ((i == _region) && (b == _block)) {
+				_offset = 0;
+				_crc = 0xFFFF;
+			}
+		}
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Keeps the cursor in FRAM so a reset resumes the scrub where it stopped.
+			Resumes from the stored cursor when it matches the regions registered, call after addRegion().
+
+    @params[in] framAddr
+                Address of 4 bytes holding the cursor
+    @returns
+				0: success
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramScrubber::setCursorStore(uint16_t framAddr)
+{
+	uint32_t cursor;
+	byte result = _fram->readLong(framAddr, &cursor);
+	if (result != ERROR_0) return result;
+
+	_cursorAddr = framAddr;
+	_persist = true;
+	_sinceSave = 0;
+
+	uint16_t region = (uint16_t)(cursor >> 16);
+	uint16_t block = (uint16_t)cursor;
+	if ((region < _regionCount) && (block < FramScrubber::blockCount(region))) {
+		_region = (uint8_t)region;
+		_block = block;
+		_offset = 0;
+		_crc = 0xFFFF;
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Scrubs for at most budgetUs microseconds. Each step reads a burst of the current block,
+			sized from the estimated cost of a byte. Returns after one full pass at most.
+			Waiting for the bus lock counts in the budget : a step is started only if it fits
+			once the lock is taken. When no estimate exists yet (the probe of addRegion() failed),
+			the call only times a 1 byte read, if the budget covers one at FRAM_SCRUB_PROBE_US a byte.
+
+    @params[in] budgetUs
+                Time allowed, in microseconds
+    @returns
+				0: success - failing blocks are reported through the callback, not here
+				13: budget too short for the smallest step, nothing done
+				return code of Wire.endTransmission() on bus error, the step is retried on next call
+*/
+/**************************************************************************/
+byte FramScrubber::poll(uint32_t budgetUs)
+{
+	if (_regionCount == 0) return ERROR_0;
+
+	uint32_t start = micros();
+	if (!_measured) {
+		_fram->busLock();
+		byte result = ERROR_13;
+		if ((micros() - start) + (1 + FRAM_SCRUB_OVERHEAD) * FRAM_SCRUB_PROBE_US <= budgetUs) {
+			result = FramScrubber::probe(_regions[_region].framAddr);
+		}
+		_fram->busUnlock();
+		return result;
+	}
+
+	uint8_t buffer[FRAM_BURST_SIZE];
+	byte result = ERROR_0;
+	boolean progress = false;
+
+	while (true) {
+		FramScrubRegion *r = &_regions[_region];
+		uint16_t blockAddr = r->framAddr + _block * r->blockSize;
+		uint8_t len = FramScrubber::blockLength(_region, _block);
+
+		// step : cursor save (4 bytes), block read (1 to a burst), or block check (2 bytes)
+		boolean save = _persist && (_sinceSave >= FRAM_SCRUB_PERSIST_BLOCKS);
+		boolean reading = !save && (_offset < len);
+		uint8_t n = save ? 4 : (reading ? len - _offset : 2);
+		if (n > FRAM_BURST_SIZE) n = FRAM_BURST_SIZE;
+		uint8_t least = reading ? 1 : n;
+
+		_fram->busLock();
+		uint32_t room = FramScrubber::room(start, budgetUs);
+		if (room < (uint32_t)least + FRAM_SCRUB_OVERHEAD) {
+			_fram->busUnlock();
+			break;
+		}
+		if ((uint32_t)n + FRAM_SCRUB_OVERHEAD > room) n = (uint8_t)(room - FRAM_SCRUB_OVERHEAD);
+		if (_decayed) n = least;	// the estimate is a guess : the smallest step checks it
+
+		uint16_t stored = 0;
+		uint32_t t0 = micros();
+		if (save) {
+			result = _fram->writeLong(_cursorAddr, ((uint32_t)_region << 16) | _block);
+		}
+		else if (reading) {
+			result = _fram->readArray(blockAddr + _offset, n, buffer);
+			if (result == ERROR_0) _crc = FRAM_MB85RC_I2C::crc16(_crc, buffer, n);
+		}
+		else {
+			result = _fram->readWord(r->crcAddr + 2 * _block, &stored);
+		}
+		FramScrubber::learn(micros() - t0, n);
+		_fram->busUnlock();
+		if (result != ERROR_0) break;
+		progress = true;
+
+		if (save) {
+			_sinceSave = 0;
+		}
+		else if (reading) {
+			_offset += n;
+		}
+		else {
+			if (stored != _crc) {
+				_errors++;
+				if (_onError != NULL) _onError(blockAddr, len);
+			}
+			FramScrubber::nextBlock();
+			if ((_region == 0) && (_block == 0)) break;	// one pass per call at most
+		}
+	}
+
+	if (!progress && (result == ERROR_0)) {
+		FramScrubber::decay();
+		return ERROR_13;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of full passes over all regions
+*/
+/**************************************************************************/
+uint32_t FramScrubber::passes(void)
+{
+	return _passes;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of blocks found failing their CRC
+*/
+/**************************************************************************/
+uint32_t FramScrubber::errors(void)
+{
+	return _errors;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Number of blocks, i.e. CRC table entries, of a region
+*/
+/**************************************************************************/
+uint16_t FramScrubber::blockCount(uint8_t regionNb)
+{
+	FramScrubRegion *r = &_regions[regionNb];
+	return (uint16_t)(((uint32_t)r->size + r->blockSize - 1) / r->blockSize);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Size of a block, the last one of a region may be shorter
+*/
+/**************************************************************************/
+uint8_t FramScrubber::blockLength(uint8_t regionNb, uint16_t block)
+{
+	FramScrubRegion *r = &_regions[regionNb];
+	uint32_t offset = (uint32_t)block * r->blockSize;
+	uint32_t left = r->size - offset;
+	return (left < r->blockSize) ? (uint8_t)left : r->blockSize;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Computes a block CRC by bursts and stores it in the CRC table
+*/
+/**************************************************************************/
+byte FramScrubber::sealBlock(uint8_t regionNb, uint16_t block)
+{
+	FramScrubRegion *r = &_regions[regionNb];
+	uint16_t addr = r->framAddr + block * r->blockSize;
+	uint8_t len = FramScrubber::blockLength(regionNb, block);
+	uint8_t buffer[FRAM_BURST_SIZE];
+	uint16_t crc = 0xFFFF;
+
+	uint8_t done = 0;
+	while (done < len) {
+		uint8_t n = len - done;
+		if (n > FRAM_BURST_SIZE) n = FRAM_BURST_SIZE;
+		byte result = _fram->readArray(addr + done, n, buffer);
+		if (result != ERROR_0) return result;
+		crc = FRAM_MB85RC_I2C::crc16(crc, buffer, n);
+		done += n;
+	}
+	return _fram->writeWord(r->crcAddr + 2 * block, crc);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Times a 1 byte read, the smallest transfer, under the bus lock : first cost estimate
+*/
+/**************************************************************************/
+byte FramScrubber::probe(uint16_t framAddr)
+{
+	uint8_t value;
+	_fram->busLock();
+	uint32_t t0 = micros();
+	byte result = _fram->readByte(framAddr, &value);
+	uint32_t elapsed = micros() - t0;
+	_fram->busUnlock();
+	if (result == ERROR_0) FramScrubber::learn(elapsed, 1);
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Bytes, address phase included, a step can still move within the budget
+*/
+/**************************************************************************/
+uint32_t FramScrubber::room(uint32_t start, uint32_t budgetUs)
+{
+	uint32_t elapsed = micros() - start;
+	if (elapsed >= budgetUs) return 0;
+	return ((budgetUs - elapsed) * 16) / (_cost + 4 * _costDev);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Updates the cost per byte estimate from a step : moving mean deviation (1/4), average
+			raised at once to a costlier step, moved down by 1/8 of a cheaper one. A step over the
+			estimate may have overrun its budget, the next ones must not. The first measure sets
+			the average, with a deviation of 1/8.
+			The floor is the lowest cost of the last FRAM_SCRUB_FLOOR_WINDOW steps : an outlier
+			does not raise it, a slower bus (clock lowered) does.
+*/
+/**************************************************************************/
+void FramScrubber::learn(uint32_t elapsed, uint16_t bytes)
+{
+	uint16_t weight = bytes + FRAM_SCRUB_OVERHEAD;
+	_decayed = false;
+	uint32_t sample = (elapsed * 16 + weight - 1) / weight;
+	if (sample == 0) sample = 1;
+
+	if (!_measured) {
+		_cost = sample;
+		_costDev = sample / 8;
+		_costFloor = sample;
+		_measured = true;
+		return;
+	}
+	if (sample < _costFloor) _costFloor = sample;
+	if (sample < _windowMin) _windowMin = sample;
+	if (++_windowCount >= FRAM_SCRUB_FLOOR_WINDOW) {
+		_costFloor = _windowMin;
+		_windowMin = 0xFFFFFFFFUL;
+		_windowCount = 0;
+	}
+
+	uint32_t diff;
+	if (sample > _cost) {
+		diff = sample - _cost;
+		_cost = sample;
+	}
+	else {
+		diff = _cost - sample;
+		_cost -= diff / 8;
+	}
+	if (diff > _costDev) _costDev += (diff - _costDev) / 4;
+	else _costDev -= (_costDev - diff) / 4;
+	if (_cost < _costFloor) _cost = _costFloor;	// no step was cheaper over a whole window
+}
+
+/**************************************************************************/
+/*!
+    @brief  Brings the estimate toward the floor when no step fits : without it an estimate
+			raised by an outlier would never be measured down again. Slowly, 1/FRAM_SCRUB_DECAY
+			a call : a bus that did become slower is not tried again within a few calls.
+*/
+/**************************************************************************/
+void FramScrubber::decay(void)
+{
+	if (_cost > _costFloor) {
+		_cost -= (_cost - _costFloor + FRAM_SCRUB_DECAY - 1) / FRAM_SCRUB_DECAY;
+		_decayed = true;
+	}
+	_costDev -= (_costDev + 3) / 4;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Moves the cursor to the next block, wrapping over regions
+*/
+/**************************************************************************/
+void FramScrubber::nextBlock(void)
+{
+	_offset = 0;
+	_crc = 0xFFFF;
+	_sinceSave++;
+	if (++_block >= FramScrubber::blockCount(_region)) {
+		_block = 0;
+		if (++_region >= _regionCount) {
+			_region = 0;
+			_passes++;
+		}
+	}
+}
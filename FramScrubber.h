@@ -0,0 +1,106 @@
+/**************************************************************************/
+/*!
+    @file     FramScrubber.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Incremental background integrity scrubber on top of FRAM_MB85RC_I2C.
+    Registered regions are split in blocks, each block has a CRC-16 stored
+    in a CRC table elsewhere in FRAM (seal() computes them). poll() walks the
+    regions by small bursts, never exceeding the time budget given, and reports
+    blocks whose content no longer matches their CRC through a callback.
+
+    The cost of a byte (bus + CRC) is learnt from the steps done, timed under
+    the bus lock so waiting for another task is not taken for bus time. The
+    estimate is an average plus 4 times the moving deviation. A step costlier
+    than the average raises it at once, cheaper steps bring it down by 1/8 :
+    an outlier (preemption...) costs a few steps sized too small, a slower
+    bus costs one step over budget. addRegion() times a 1 byte read, the
+    first poll() starts from that measure. Each step is sized to fit what
+    remains of the budget : poll(200) can run from a 1 kHz control loop. When not even the smallest step fits, poll() does
+    nothing and returns ERROR_13 while the estimate slowly decays toward the
+    lowest cost of the last steps, so a budget that became large enough
+    resumes the scrub. The first step after a decay is the smallest one, the
+    estimate is checked at the cost of 1 byte read.
+    Application writes into a protected region must be followed by
+    sealRange(), or the block will be reported.
+    The cursor can be saved in FRAM (setCursorStore()) to resume after a reset.
+    Pinned regions are read from their RAM mirror, do not register them.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_SCRUBBER_H_
+#define _FRAM_SCRUBBER_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+#ifndef FRAM_SCRUB_MAX_REGIONS
+#define FRAM_SCRUB_MAX_REGIONS 4
+#endif
+#define FRAM_SCRUB_OVERHEAD 4			// address phase cost, in bytes equivalent
+#define FRAM_SCRUB_FLOOR_WINDOW 8		// steps over which the lowest cost is taken
+#define FRAM_SCRUB_PERSIST_BLOCKS 16	// blocks checked between two cursor saves
+#define FRAM_SCRUB_DECAY 256			// estimate brought 1/N closer to the floor by each call doing nothing
+#define FRAM_SCRUB_PROBE_US 90			// cost of a byte, in microseconds, assumed before any measure (100 kHz)
+
+typedef struct {
+	uint16_t	framAddr;
+	uint16_t	size;
+	uint16_t	crcAddr;		// CRC table : one uint16_t per block
+	uint8_t		blockSize;
+} FramScrubRegion;
+
+
+class FramScrubber {
+ public:
+	FramScrubber(FRAM_MB85RC_I2C *fram, void (*onError)(uint16_t framAddr, uint16_t items));
+
+	byte	addRegion(uint16_t framAddr, uint16_t size, uint8_t blockSize, uint16_t crcAddr);
+	byte	seal(uint8_t regionNb);
+	byte	sealRange(uint16_t framAddr, uint16_t items);
+	byte	setCursorStore(uint16_t framAddr);
+	byte	poll(uint32_t budgetUs);
+
+	uint32_t	passes(void);
+	uint32_t	errors(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	void		(*_onError)(uint16_t framAddr, uint16_t items);
+	FramScrubRegion	_regions[FRAM_SCRUB_MAX_REGIONS];
+	uint8_t		_regionCount;
+
+	// cursor
+	uint8_t		_region;
+	uint16_t	_block;
+	uint8_t		_offset;
+	uint16_t	_crc;
+	boolean		_persist;
+	uint16_t	_cursorAddr;
+	uint8_t		_sinceSave;
+
+	// cost of a byte, in 1/16 microseconds
+	uint32_t	_cost;			// moving average
+	uint32_t	_costDev;		// moving mean deviation
+	uint32_t	_costFloor;		// lowest of the last window, or lower seen since
+	uint32_t	_windowMin;
+	uint8_t		_windowCount;
+	boolean		_measured;
+	boolean		_decayed;		// lowered by decay(), not measured since : next step is the smallest
+	uint32_t	_passes;
+	uint32_t	_errors;
+
+	uint16_t	blockCount(uint8_t regionNb);
+	uint8_t		blockLength(uint8_t regionNb, uint16_t block);
+	byte		sealBlock(uint8_t regionNb, uint16_t block);
+	byte		probe(uint16_t framAddr);
+	uint32_t	room(uint32_t start, uint32_t budgetUs);
+	void		learn(uint32_t elapsed, uint16_t bytes);
+	void		decay(void);
+	void		nextBlock(void);
+};
+
+#endif
@@ -0,0 +1,313 @@
+/**************************************************************************/
+/*!
+    @file     FramSlabAllocator.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Persistent fixed size slots allocator on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramSlabAllocator.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the allocator lives on
+    @params[in] baseAddr
+                First address of the allocator region
+    @params[in] classes[]
+                Slot size & slot count of each class
+    @params[in] classCount
+                Number of classes, up to FRAM_SLAB_MAX_CLASSES
+*/
+/**************************************************************************/
+FramSlabAllocator::FramSlabAllocator(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, const FramSlabClass classes[], uint8_t classCount)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_classCount = (classCount > FRAM_SLAB_MAX_CLASSES) ? FRAM_SLAB_MAX_CLASSES : classCount;
+	_valid = (classCount > 0) && (classCount <= FRAM_SLAB_MAX_CLASSES);
+
+	uint32_t total = 0;
+	for (uint8_t c = 0; c < _classCount; c++) {
+		_classes[c] = classes[c];
+		_firstBit[c] = (uint16_t)total;
+		_free[c] = 0;
+		_next[c] = 0;
+		total += classes[c].slotCount;
+		if (classes[c].slotSize == 0) _valid = false;
+	}
+	if (total > (8UL * FRAM_SLAB_BITMAP_SIZE)) {
+		_valid = false;
+		total = 0;
+	}
+	_totalSlots = (uint16_t)total;
+
+	uint32_t addr = (uint32_t)_base + FRAM_SLAB_HEADER_SIZE + FramSlabAllocator::bitmapBytes();
+	for (uint8_t c = 0; c < _classCount; c++) {
+		_firstSlot[c] = (uint16_t)addr;
+		addr += (uint32_t)_classes[c].slotSize * _classes[c].slotCount;
+	}
+	if (addr > 0x10000UL) _valid = false;
+	_end = (uint16_t)addr;
+
+	memset(_bitmap, 0, sizeof(_bitmap));
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Rebuilds the RAM bitmap from FRAM with one sequential read
+
+    @returns
+				0: success
+				10: class table does not fit FRAM_SLAB_BITMAP_SIZE / FRAM_SLAB_MAX_CLASSES or the 64K memory map
+				12: region not formatted with this class table - call format()
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramSlabAllocator::begin(void)
+{
+	if (!_valid) return ERROR_10;
+
+	byte result = _fram->readBlock(_base, FRAM_SLAB_HEADER_SIZE + FramSlabAllocator::bitmapBytes(), _bitmap);
+	if (result != ERROR_0) return result;
+
+	uint16_t sign = *reinterpret_cast<uint16_t *>(_bitmap);
+	if (sign != FramSlabAllocator::signature()) {
+		memset(_bitmap, 0, sizeof(_bitmap));
+		return ERROR_12;
+	}
+
+	for (uint8_t c = 0; c < _classCount; c++) {
+		_free[c] = 0;
+		_next[c] = 0;
+		for (uint16_t i = 0; i < _classes[c].slotCount; i++) {
+			uint16_t bit = _firstBit[c] + i;
+			if (bitRead(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07)) continue;
+			if (_free[c] == 0) _next[c] = i;
+			_free[c]++;
+		}
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Marks every slot free and writes the layout signature. Slot contents are left untouched.
+
+    @returns
+				0: success
+				10: invalid class table
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramSlabAllocator::format(void)
+{
+	if (!_valid) return ERROR_10;
+
+	memset(_bitmap, 0, sizeof(_bitmap));
+	*reinterpret_cast<uint16_t *>(_bitmap) = FramSlabAllocator::signature();
+
+	byte result = _fram->writeBlock(_base, FRAM_SLAB_HEADER_SIZE + FramSlabAllocator::bitmapBytes(), _bitmap);
+	for (uint8_t c = 0; c < _classCount; c++) {
+		_free[c] = (result == ERROR_0) ? _classes[c].slotCount : 0;
+		_next[c] = 0;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Allocates a slot from the smallest class able to hold size bytes.
+			The allocation is persisted before returning - a power loss right after
+			leaves the slot allocated, it is never handed out twice.
+
+    @params[in] size
+                Number of bytes needed
+    @params[out] framAddr
+                FRAM address of the slot
+    @returns
+				0: success
+				10: allocator not started
+				11: no free slot large enough
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramSlabAllocator::alloc(uint16_t size, uint16_t *framAddr)
+{
+	if (!_valid) return ERROR_10;
+
+	uint8_t best = FRAM_SLAB_MAX_CLASSES;
+	for (uint8_t c = 0; c < _classCount; c++) {
+		if ((_classes[c].slotSize >= size) && (_free[c] > 0)) {
+			if ((best == FRAM_SLAB_MAX_CLASSES) || (_classes[c].slotSize < _classes[best].slotSize)) best = c;
+		}
+	}
+	if (best == FRAM_SLAB_MAX_CLASSES) return ERROR_11;
+
+	// from the hint, wrapping at the end of the class
+	uint16_t count = _classes[best].slotCount;
+	uint16_t slot = _next[best];
+	uint16_t seen = 0;
+	uint16_t bit = _firstBit[best] + slot;
+	while (seen < count) {
+		bit = _firstBit[best] + slot;
+		uint8_t value = _bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)];
+		if (((bit & 0x07) == 0) && (value == 0xFF) && ((slot + 8) <= count)) {
+			seen += 8;	// full byte, skip it
+			slot += 8;
+			if (slot == count) slot = 0;
+			continue;
+		}
+		if (!bitRead(value, bit & 0x07)) break;
+		seen++;
+		if (++slot == count) slot = 0;
+	}
+	if (seen >= count) return ERROR_11;	// free count out of sync, should never happen
+
+	bitSet(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07);
+	byte result = FramSlabAllocator::persistBit(bit);
+	if (result != ERROR_0) {
+		bitClear(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07);
+		return result;
+	}
+
+	_free[best]--;
+	_next[best] = (slot + 1 == count) ? 0 : slot + 1;
+	*framAddr = _firstSlot[best] + (bit - _firstBit[best]) * _classes[best].slotSize;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Releases a slot
+
+    @params[in] framAddr
+                FRAM address returned by alloc()
+    @returns
+				0: success
+				10: address is not the start of an allocated slot (double free)
+				11: address outside of the slots area
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramSlabAllocator::free(uint16_t framAddr)
+{
+	uint8_t c;
+	int slot = FramSlabAllocator::findSlot(framAddr, &c);
+	if (slot == -1) return ERROR_11;
+	if (slot == -2) return ERROR_10;
+
+	uint16_t bit = _firstBit[c] + (uint16_t)slot;
+	if (!bitRead(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07)) return ERROR_10;
+
+	bitClear(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07);
+	byte result = FramSlabAllocator::persistBit(bit);
+	if (result != ERROR_0) {
+		bitSet(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07);
+		return result;
+	}
+	_free[c]++;
+	_next[c] = (uint16_t)slot;	// known free
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells if the slot starting at framAddr is allocated - RAM lookup only
+*/
+/**************************************************************************/
+boolean FramSlabAllocator::isAllocated(uint16_t framAddr)
+{
+	uint8_t c;
+	int slot = FramSlabAllocator::findSlot(framAddr, &c);
+	if (slot < 0) return false;
+
+	uint16_t bit = _firstBit[c] + (uint16_t)slot;
+	return bitRead(_bitmap[FRAM_SLAB_HEADER_SIZE + (bit >> 3)], bit & 0x07);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of free slots in a class
+*/
+/**************************************************************************/
+uint16_t FramSlabAllocator::freeSlots(uint8_t classNb)
+{
+	if (classNb >= _classCount) return 0;
+	return _free[classNb];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of FRAM bytes used by the allocator region, metadata included
+*/
+/**************************************************************************/
+uint16_t FramSlabAllocator::footprint(void)
+{
+	return _end - _base;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+uint16_t FramSlabAllocator::signature(void)
+{
+	uint16_t crc = FRAM_MB85RC_I2C::crc16(0xFFFF, &_classCount, 1);
+	return FRAM_MB85RC_I2C::crc16(crc, reinterpret_cast<const uint8_t *>(_classes), _classCount * sizeof(FramSlabClass));
+}
+
+uint16_t FramSlabAllocator::bitmapBytes(void)
+{
+	return (_totalSlots + 7) >> 3;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Finds the class & slot index of an address
+
+    @returns    slot index in its class, -1 out of the slots area, -2 not the start of a slot
+*/
+/**************************************************************************/
+int FramSlabAllocator::findSlot(uint16_t framAddr, uint8_t *classNb)
+{
+	if (!_valid) return -1;
+
+	for (uint8_t c = 0; c < _classCount; c++) {
+		uint32_t classEnd = (uint32_t)_firstSlot[c] + (uint32_t)_classes[c].slotSize * _classes[c].slotCount;
+		if ((framAddr >= _firstSlot[c]) && (framAddr < classEnd)) {
+			uint16_t offset = framAddr - _firstSlot[c];
+			if ((offset % _classes[c].slotSize) != 0) return -2;
+			*classNb = c;
+			return offset / _classes[c].slotSize;
+		}
+	}
+	return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the bitmap byte holding a bit - a single byte transaction
+*/
+/**************************************************************************/
+byte FramSlabAllocator::persistBit(uint16_t bit)
+{
+	uint16_t offset = FRAM_SLAB_HEADER_SIZE + (bit >> 3);
+	return _fram->writeByte(_base + offset, _bitmap[offset]);
+}
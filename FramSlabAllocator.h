@@ -0,0 +1,79 @@
+/**************************************************************************/
+/*!
+    @file     FramSlabAllocator.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Persistent fixed size slots allocator on top of FRAM_MB85RC_I2C.
+    Slots are grouped in size classes. The allocation bitmap lives in FRAM
+    and is mirrored in RAM : alloc() & free() only look at RAM and persist
+    the change by writing the single bitmap byte concerned. begin() rebuilds
+    the RAM mirror with one sequential read. Each class keeps the slot its
+    next search starts from - the last one freed, or the one after the last
+    allocated - so alloc() usually finds a free slot at the first bit read.
+
+    FRAM layout of an allocator region :
+      [0..1]  layout signature (CRC of the class table)
+      [2..]   allocation bitmap, 1 bit per slot - 1 means allocated
+      [..]    slots of class 0, then slots of class 1...
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_SLAB_ALLOCATOR_H_
+#define _FRAM_SLAB_ALLOCATOR_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// RAM budget : bitmap bytes (8 slots per byte, all classes) & number of classes
+#ifndef FRAM_SLAB_BITMAP_SIZE
+#define FRAM_SLAB_BITMAP_SIZE 32
+#endif
+#ifndef FRAM_SLAB_MAX_CLASSES
+#define FRAM_SLAB_MAX_CLASSES 4
+#endif
+
+#define FRAM_SLAB_HEADER_SIZE 2
+
+typedef struct {
+	uint16_t	slotSize;
+	uint16_t	slotCount;
+} FramSlabClass;
+
+
+class FramSlabAllocator {
+ public:
+	FramSlabAllocator(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, const FramSlabClass classes[], uint8_t classCount);
+
+	byte	begin(void);
+	byte	format(void);
+	byte	alloc(uint16_t size, uint16_t *framAddr);
+	byte	free(uint16_t framAddr);
+	boolean	isAllocated(uint16_t framAddr);
+
+	uint16_t	freeSlots(uint8_t classNb);
+	uint16_t	footprint(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	FramSlabClass	_classes[FRAM_SLAB_MAX_CLASSES];
+	uint8_t		_classCount;
+	uint16_t	_firstBit[FRAM_SLAB_MAX_CLASSES];	// bitmap index of the first slot of each class
+	uint16_t	_firstSlot[FRAM_SLAB_MAX_CLASSES];	// FRAM address of the first slot of each class
+	uint16_t	_free[FRAM_SLAB_MAX_CLASSES];
+	uint16_t	_next[FRAM_SLAB_MAX_CLASSES];	// slot of the class the next search starts from
+	uint16_t	_totalSlots;
+	uint16_t	_end;
+	boolean		_valid;
+	uint8_t		_bitmap[FRAM_SLAB_HEADER_SIZE + FRAM_SLAB_BITMAP_SIZE];	// header + bitmap, as laid out in FRAM
+
+	uint16_t	signature(void);
+	uint16_t	bitmapBytes(void);
+	int			findSlot(uint16_t framAddr, uint8_t *classNb);
+	byte		persistBit(uint16_t bit);
+};
+
+#endif
@@ -0,0 +1,278 @@
+/**************************************************************************/
+/*!
+    @file     FramStream.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Arduino Stream over a FRAM region.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramStream.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the stream lives on
+    @params[in] baseAddr
+                First address of the stream region
+    @params[in] size
+                Size of the stream region in bytes
+*/
+/**************************************************************************/
+FramStream::FramStream(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_size = size;
+	_length = 0;
+	_status = ERROR_0;
+	_writePos = 0;
+	_wlen = 0;
+	_readPos = 0;
+	_rstart = 0;
+	_rlen = 0;
+}
+
+FramStream::~FramStream()
+{
+	FramStream::flushWrite();
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Print interface - buffers one byte, a full buffer is written as one burst
+
+    @returns    1 if the byte was accepted, 0 if the region is full or the chip failed
+*/
+/**************************************************************************/
+size_t FramStream::write(uint8_t value)
+{
+	return FramStream::write(&value, 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Print interface - buffers bytes, full buffers are written as bursts
+
+    @returns    number of bytes accepted
+*/
+/**************************************************************************/
+size_t FramStream::write(const uint8_t *buffer, size_t size)
+{
+	size_t done = 0;
+	while (done < size) {
+		if ((_writePos >= _size) || (_status != ERROR_0)) {
+			setWriteError();
+			break;
+		}
+		uint16_t room = FRAM_BURST_SIZE - _wlen;
+		if (room > (_size - _writePos)) room = _size - _writePos;
+		if (room > (size - done)) room = size - done;
+
+		FramStream::dropReadBuffer(_writePos, _writePos + room);
+		memcpy(&_wbuf[_wlen], &buffer[done], room);
+		_wlen += room;
+		_writePos += room;
+		done += room;
+		if (_writePos > _length) _length = _writePos;
+
+		if ((_wlen == FRAM_BURST_SIZE) && (FramStream::flushWrite() != ERROR_0)) break;
+	}
+	return done;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of bytes that can still be written before the region is full
+*/
+/**************************************************************************/
+int FramStream::availableForWrite(void)
+{
+	return _size - _writePos;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the buffered bytes to the chip
+*/
+/**************************************************************************/
+void FramStream::flush(void)
+{
+	FramStream::flushWrite();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stream interface - number of bytes between the read position and the stream length
+*/
+/**************************************************************************/
+int FramStream::available(void)
+{
+	return (_readPos < _length) ? (_length - _readPos) : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stream interface - next byte, -1 at the end of the stream or on bus error
+*/
+/**************************************************************************/
+int FramStream::read(void)
+{
+	int value = FramStream::peek();
+	if (value >= 0) _readPos++;
+	return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stream interface - next byte without moving the read position
+*/
+/**************************************************************************/
+int FramStream::peek(void)
+{
+	if (_readPos >= _length) return -1;
+	if ((_rlen == 0) || (_readPos < _rstart) || (_readPos >= (_rstart + _rlen))) {
+		if (FramStream::refill() != ERROR_0) return -1;
+	}
+	return _rbuf[_readPos - _rstart];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Moves the write position, buffered bytes are flushed first
+
+    @returns    0: success, 11: position beyond the region, or bus error
+*/
+/**************************************************************************/
+byte FramStream::seekWrite(uint16_t pos)
+{
+	if (pos > _size) return ERROR_11;
+	byte result = FramStream::flushWrite();
+	if (result == ERROR_0) _writePos = pos;
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Moves the read position
+
+    @returns    0: success, 11: position beyond the region
+*/
+/**************************************************************************/
+byte FramStream::seekRead(uint16_t pos)
+{
+	if (pos > _size) return ERROR_11;
+	_readPos = pos;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the readable length, e.g. restored after a reboot. Also moves the write position there.
+
+    @returns    0: success, 11: length beyond the region, or bus error
+*/
+/**************************************************************************/
+byte FramStream::setLength(uint16_t length)
+{
+	byte result = FramStream::seekWrite(length);
+	if (result == ERROR_0) _length = length;
+	return result;
+}
+
+uint16_t FramStream::writePosition(void)
+{
+	return _writePos;
+}
+
+uint16_t FramStream::readPosition(void)
+{
+	return _readPos;
+}
+
+uint16_t FramStream::length(void)
+{
+	return _length;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Last bus error - the stream stops accepting bytes after an error until cleared here
+*/
+/**************************************************************************/
+byte FramStream::status(void)
+{
+	byte result = _status;
+	_status = ERROR_0;
+	clearWriteError();
+	return result;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Writes the write buffer as one burst
+*/
+/**************************************************************************/
+byte FramStream::flushWrite(void)
+{
+	if (_wlen == 0) return ERROR_0;
+
+	byte result = _fram->writeArray(_base + _writePos - _wlen, _wlen, _wbuf);
+	if (result != ERROR_0) _status = result;
+	_wlen = 0;
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Loads a burst from the read position. Pending writes are flushed first so they are read back.
+*/
+/**************************************************************************/
+byte FramStream::refill(void)
+{
+	byte result = FramStream::flushWrite();
+	if (result != ERROR_0) return result;
+
+	uint16_t n = _length - _readPos;
+	if (n > FRAM_BURST_SIZE) n = FRAM_BURST_SIZE;
+
+	_rlen = 0;
+	result = _fram->readArray(_base + _readPos, (byte)n, _rbuf);
+	if (result != ERROR_0) {
+		_status = result;
+	}
+	else {
+		_rstart = _readPos;
+		_rlen = (uint8_t)n;
+	}
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drops the read buffer if it holds bytes of [from, to) about to be rewritten
+*/
+/**************************************************************************/
+void FramStream::dropReadBuffer(uint16_t from, uint16_t to)
+{
+	if ((_rlen > 0) && (from < (_rstart + _rlen)) && (to > _rstart)) _rlen = 0;
+}
@@ -0,0 +1,72 @@
+/**************************************************************************/
+/*!
+    @file     FramStream.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Arduino Stream over a FRAM region : print(), write() and Stream::readBytes()
+    work directly against the chip. Writes are gathered in a RAM buffer
+    flushed by bursts, reads refill a RAM buffer by bursts.
+
+    The stream is linear : once the region is full, write() returns 0 and
+    sets the write error. The readable length is the highest position written,
+    restore it with setLength() after a reboot.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_STREAM_H_
+#define _FRAM_STREAM_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+
+class FramStream : public Stream {
+ public:
+	FramStream(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size);
+	~FramStream();
+
+	// Print
+	size_t	write(uint8_t value);
+	size_t	write(const uint8_t *buffer, size_t size);
+	int		availableForWrite(void);
+	void	flush(void);
+	using	Print::write;
+
+	// Stream
+	int		available(void);
+	int		read(void);
+	int		peek(void);
+
+	byte	seekWrite(uint16_t pos);
+	byte	seekRead(uint16_t pos);
+	byte	setLength(uint16_t length);
+	uint16_t	writePosition(void);
+	uint16_t	readPosition(void);
+	uint16_t	length(void);
+	byte	status(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint16_t	_size;
+	uint16_t	_length;
+	byte		_status;
+
+	uint16_t	_writePos;		// stream position of the next byte written (buffered ones included)
+	uint8_t		_wbuf[FRAM_BURST_SIZE];
+	uint8_t		_wlen;
+
+	uint16_t	_readPos;
+	uint16_t	_rstart;		// stream position of _rbuf[0]
+	uint8_t		_rbuf[FRAM_BURST_SIZE];
+	uint8_t		_rlen;			// 0 means read buffer empty
+
+	byte	flushWrite(void);
+	byte	refill(void);
+	void	dropReadBuffer(uint16_t from, uint16_t to);
+};
+
+#endif
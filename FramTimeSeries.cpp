@@ -0,0 +1,413 @@
+/**************************************************************************/
+/*!
+    @file     FramTimeSeries.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Time series sample store on top of FRAM_MB85RC_I2C.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FramTimeSeries.h"
+
+/*========================================================================*/
+/*                            CONSTRUCTORS                                */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    Constructor
+
+    @params[in] fram
+                FRAM_MB85RC_I2C object the store lives on
+    @params[in] baseAddr
+                First address of the store region
+    @params[in] size
+                Size of the region - split in size / blockSize blocks, up to FRAM_TS_MAX_BLOCKS
+    @params[in] blockSize
+                Size of one block, header included, up to FRAM_TS_BLOCK_MAX
+*/
+/**************************************************************************/
+FramTimeSeries::FramTimeSeries(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size, uint8_t blockSize)
+{
+	_fram = fram;
+	_base = baseAddr;
+	_blockSize = blockSize;
+	_blockCount = 0;
+	if ((blockSize > (FRAM_TS_HEADER_SIZE + FRAM_TS_SAMPLE_MAX)) && (blockSize <= FRAM_TS_BLOCK_MAX)) {
+		uint16_t blocks = size / blockSize;
+		_blockCount = (blocks > FRAM_TS_MAX_BLOCKS) ? 0 : (uint8_t)blocks;
+	}
+	_newest = FRAM_TS_NO_BLOCK;
+	_used = 0;
+	_seq = 0;
+	_count = 0;
+	_lastTs = 0;
+	_lastValue = 0;
+}
+
+/*========================================================================*/
+/*                           PUBLIC FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Rebuilds the RAM index from the block headers and restores the append state from the newest block
+
+    @returns
+				0: success
+				10: invalid geometry (block size, FRAM_TS_MAX_BLOCKS)
+				12: headers inconsistent - region not formatted
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramTimeSeries::begin(void)
+{
+	if (_blockCount < 2) return ERROR_10;
+
+	uint16_t seqs[FRAM_TS_MAX_BLOCKS];
+	boolean inUse[FRAM_TS_MAX_BLOCKS];
+	FramTSHeader header;
+	byte result;
+
+	_used = 0;
+	_newest = FRAM_TS_NO_BLOCK;
+	for (uint8_t b = 0; b < _blockCount; b++) {
+		result = _fram->readArray(FramTimeSeries::blockAddress(b), FRAM_TS_HEADER_SIZE, reinterpret_cast<uint8_t *>(&header));
+		if (result != ERROR_0) return result;
+
+		inUse[b] = (header.count != FRAM_TS_UNUSED);
+		if (!inUse[b]) {
+			seqs[b] = 0;
+			_bytes[b] = 0;
+			_firstTs[b] = 0;
+			continue;
+		}
+		if ((header.bytes > (_blockSize - FRAM_TS_HEADER_SIZE)) || (header.count > header.bytes) || (header.lastTs < header.firstTs)) return ERROR_12;
+
+		seqs[b] = header.seq;
+		_bytes[b] = (uint8_t)header.bytes;
+		_firstTs[b] = header.firstTs;
+		_used++;
+	}
+	if (_used == 0) return ERROR_0;
+
+	// the newest block is the only used one not followed by its successor in sequence
+	for (uint8_t b = 0; b < _blockCount; b++) {
+		uint8_t next = (b + 1) % _blockCount;
+		if (!inUse[b]) continue;
+		if (!inUse[next] || (seqs[next] != (uint16_t)(seqs[b] + 1))) {
+			if (_newest != FRAM_TS_NO_BLOCK) return ERROR_12;
+			_newest = b;
+		}
+	}
+	if (_newest == FRAM_TS_NO_BLOCK) return ERROR_12;
+	_seq = seqs[_newest];
+
+	// replay the newest block to restore the deltas base
+	result = FramTimeSeries::loadBlock(_newest, &header);
+	if (result != ERROR_0) return result;
+	uint32_t ts = header.firstTs;
+	uint32_t value = 0;
+	uint8_t pos = FRAM_TS_HEADER_SIZE;
+	uint8_t end = FRAM_TS_HEADER_SIZE + header.bytes;
+	for (uint16_t c = 0; c < header.count; c++) {
+		uint32_t dts, zz;
+		pos += FramTimeSeries::getVarint(&_buf[pos], end - pos, &dts);
+		pos += FramTimeSeries::getVarint(&_buf[pos], end - pos, &zz);
+		ts += dts;
+		value += (zz >> 1) ^ (~(zz & 1) + 1);
+	}
+	_count = header.count;
+	_lastTs = ts;
+	_lastValue = (int32_t)value;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Empties the store - every block header is marked unused
+
+    @returns
+				0: success
+				10: invalid geometry
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramTimeSeries::format(void)
+{
+	if (_blockCount < 2) return ERROR_10;
+
+	FramTSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.count = FRAM_TS_UNUSED;
+
+	byte result = ERROR_0;
+	for (uint8_t b = 0; (b < _blockCount) && (result == ERROR_0); b++) {
+		result = _fram->writeArray(FramTimeSeries::blockAddress(b), FRAM_TS_HEADER_SIZE, reinterpret_cast<uint8_t *>(&header));
+		_firstTs[b] = 0;
+		_bytes[b] = 0;
+	}
+	_newest = FRAM_TS_NO_BLOCK;
+	_used = 0;
+	_seq = 0;
+	_count = 0;
+	_lastTs = 0;
+	_lastValue = 0;
+	return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Appends one sample. The sample bytes are written first, then the block header,
+			so a power loss never exposes a partially written sample.
+
+    @params[in] timestamp
+                Sample time, not older than the previous sample
+    @params[in] value
+                Sample value
+    @returns
+				0: success
+				10: store not started or timestamp older than the previous sample
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramTimeSeries::append(uint32_t timestamp, int32_t value)
+{
+	if (_blockCount < 2) return ERROR_10;
+	if ((_newest != FRAM_TS_NO_BLOCK) && (timestamp < _lastTs)) return ERROR_10;
+
+	uint8_t sample[FRAM_TS_SAMPLE_MAX];
+	uint8_t n = 0;
+	byte result;
+
+	if (_newest != FRAM_TS_NO_BLOCK) {
+		uint32_t dv = (uint32_t)value - (uint32_t)_lastValue;
+		n = FramTimeSeries::putVarint(sample, timestamp - _lastTs);
+		n += FramTimeSeries::putVarint(&sample[n], (dv << 1) ^ (uint32_t)((int32_t)dv >> 31));
+	}
+	if ((_newest == FRAM_TS_NO_BLOCK) || ((_bytes[_newest] + n) > (_blockSize - FRAM_TS_HEADER_SIZE))) {
+		result = FramTimeSeries::openBlock(timestamp);
+		if (result != ERROR_0) return result;
+		uint32_t dv = (uint32_t)value;
+		n = FramTimeSeries::putVarint(sample, 0);
+		n += FramTimeSeries::putVarint(&sample[n], (dv << 1) ^ (uint32_t)(value >> 31));
+	}
+
+	uint16_t blockAddr = FramTimeSeries::blockAddress(_newest);
+	result = _fram->writeArray(blockAddr + FRAM_TS_HEADER_SIZE + _bytes[_newest], n, sample);
+	if (result != ERROR_0) return result;
+
+	FramTSHeader header;
+	header.seq = _seq;
+	header.count = _count + 1;
+	header.bytes = _bytes[_newest] + n;
+	header.firstTs = _firstTs[_newest];
+	header.lastTs = timestamp;
+	// everything but the sequence number, in one transaction
+	result = _fram->writeArray(blockAddr + 2, FRAM_TS_HEADER_SIZE - 2, reinterpret_cast<uint8_t *>(&header) + 2);
+	if (result != ERROR_0) return result;
+
+	_count++;
+	_bytes[_newest] += n;
+	_lastTs = timestamp;
+	_lastValue = value;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the samples with t1 <= timestamp <= t2, oldest first.
+			The first block is found by binary search in the RAM index, only blocks
+			overlapping the range are read. When found == maxSamples, call again from the
+			last timestamp returned, skipping the samples of that timestamp already returned.
+
+    @params[in] t1, t2
+                Time range, bounds included
+    @params[out] timestamps[], values[]
+                Samples found
+    @params[in] maxSamples
+                Size of the output arrays
+    @params[out] found
+                Number of samples returned
+    @params[in] skip
+                Samples stamped t1 not returned - those of the previous page
+    @returns
+				0: success
+				10: store not started
+				return code of Wire.endTransmission() on bus error
+*/
+/**************************************************************************/
+byte FramTimeSeries::query(uint32_t t1, uint32_t t2, uint32_t timestamps[], int32_t values[], uint16_t maxSamples, uint16_t *found, uint16_t skip)
+{
+	*found = 0;
+	if (_blockCount < 2) return ERROR_10;
+	if ((_used == 0) || (t2 < t1)) return ERROR_0;
+
+	// last block starting before t1 - the blocks before it end before t1, the next ones may start at t1
+	// while it ends with samples stamped t1
+	uint8_t lo = 0;
+	uint8_t hi = _used;
+	while ((hi - lo) > 1) {
+		uint8_t mid = (lo + hi) / 2;
+		if (_firstTs[FramTimeSeries::physical(mid)] < t1) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	for (uint8_t l = lo; l < _used; l++) {
+		uint8_t block = FramTimeSeries::physical(l);
+		if (_firstTs[block] > t2) break;
+
+		FramTSHeader header;
+		byte result = FramTimeSeries::loadBlock(block, &header);
+		if (result != ERROR_0) return result;
+		if (header.lastTs < t1) continue;
+
+		uint32_t ts = header.firstTs;
+		uint32_t value = 0;
+		uint8_t pos = FRAM_TS_HEADER_SIZE;
+		uint8_t end = FRAM_TS_HEADER_SIZE + header.bytes;
+		for (uint16_t c = 0; c < header.count; c++) {
+			uint32_t dts, zz;
+			pos += FramTimeSeries::getVarint(&_buf[pos], end - pos, &dts);
+			pos += FramTimeSeries::getVarint(&_buf[pos], end - pos, &zz);
+			ts += dts;
+			value += (zz >> 1) ^ (~(zz & 1) + 1);
+			if (ts < t1) continue;
+			if ((ts == t1) && (skip > 0)) {
+				skip--;
+				continue;
+			}
+			if ((ts > t2) || (*found == maxSamples)) return ERROR_0;
+			timestamps[*found] = ts;
+			values[*found] = (int32_t)value;
+			(*found)++;
+		}
+	}
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Timestamp of the oldest sample kept, 0 if empty
+*/
+/**************************************************************************/
+uint32_t FramTimeSeries::firstTimestamp(void)
+{
+	return (_used == 0) ? 0 : _firstTs[FramTimeSeries::physical(0)];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Timestamp of the newest sample, 0 if empty
+*/
+/**************************************************************************/
+uint32_t FramTimeSeries::lastTimestamp(void)
+{
+	return (_used == 0) ? 0 : _lastTs;
+}
+
+uint8_t FramTimeSeries::blockCount(void)
+{
+	return _blockCount;
+}
+
+uint8_t FramTimeSeries::usedBlocks(void)
+{
+	return _used;
+}
+
+/*========================================================================*/
+/*                           PRIVATE FUNCTIONS                            */
+/*========================================================================*/
+
+uint16_t FramTimeSeries::blockAddress(uint8_t block)
+{
+	return _base + (uint16_t)block * _blockSize;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Physical block of the logical position (0 = oldest)
+*/
+/**************************************************************************/
+uint8_t FramTimeSeries::physical(uint8_t logical)
+{
+	return (uint8_t)((_newest + 1 + _blockCount - _used + logical) % _blockCount);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts the next block of the ring - the oldest one is dropped when the ring is full
+*/
+/**************************************************************************/
+byte FramTimeSeries::openBlock(uint32_t timestamp)
+{
+	uint8_t next = (_newest == FRAM_TS_NO_BLOCK) ? 0 : (_newest + 1) % _blockCount;
+	uint16_t seq = (_newest == FRAM_TS_NO_BLOCK) ? 1 : _seq + 1;
+
+	FramTSHeader header;
+	header.seq = seq;
+	header.count = 0;
+	header.bytes = 0;
+	header.firstTs = timestamp;
+	header.lastTs = timestamp;
+	byte result = _fram->writeArray(FramTimeSeries::blockAddress(next), FRAM_TS_HEADER_SIZE, reinterpret_cast<uint8_t *>(&header));
+	if (result != ERROR_0) return result;
+
+	if (_used < _blockCount) _used++;
+	_newest = next;
+	_seq = seq;
+	_firstTs[next] = timestamp;
+	_bytes[next] = 0;
+	_count = 0;
+	_lastTs = timestamp;
+	_lastValue = 0;
+	return ERROR_0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads header & used payload of a block in _buf
+*/
+/**************************************************************************/
+byte FramTimeSeries::loadBlock(uint8_t block, FramTSHeader *header)
+{
+	byte result = _fram->readBlock(FramTimeSeries::blockAddress(block), FRAM_TS_HEADER_SIZE + _bytes[block], _buf);
+	memcpy(header, _buf, FRAM_TS_HEADER_SIZE);
+	if ((result == ERROR_0) && (header->bytes != _bytes[block])) result = ERROR_12;
+	return result;
+}
+
+uint8_t FramTimeSeries::putVarint(uint8_t buf[], uint32_t value)
+{
+	uint8_t n = 0;
+	while (value >= 0x80) {
+		buf[n++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	buf[n++] = (uint8_t)value;
+	return n;
+}
+
+uint8_t FramTimeSeries::getVarint(const uint8_t buf[], uint8_t len, uint32_t *value)
+{
+	uint32_t result = 0;
+	uint8_t n = 0;
+	while (n < len) {
+		uint8_t b = buf[n];
+		result |= (uint32_t)(b & 0x7F) << (7 * n);
+		n++;
+		if ((b & 0x80) == 0) break;
+	}
+	*value = result;
+	return n;
+}
@@ -0,0 +1,96 @@
+/**************************************************************************/
+/*!
+    @file     FramTimeSeries.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Time series sample store on top of FRAM_MB85RC_I2C.
+    The region is a ring of fixed size blocks, the oldest block is reused
+    when the ring is full. Inside a block each sample is stored as the
+    timestamp delta (varint) and the value delta (zigzag varint) from the
+    previous sample. The first timestamp of each block is kept in a RAM
+    index so a range query binary searches its first block and reads only
+    the blocks holding the result.
+
+    Timestamps must be non decreasing, samples may share a timestamp - also
+    across a block boundary. Block layout :
+      [0..1]   sequence number
+      [2..3]   samples count (0xFFFF : block never used)
+      [4..5]   payload bytes
+      [6..9]   first timestamp
+      [10..13] last timestamp
+      [14..]   payload
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_TIME_SERIES_H_
+#define _FRAM_TIME_SERIES_H_
+
+#include "FRAM_MB85RC_I2C.h"
+
+// RAM budget : blocks in the ring (5 bytes of index each) & largest block size (query buffer)
+#ifndef FRAM_TS_MAX_BLOCKS
+#define FRAM_TS_MAX_BLOCKS 64
+#endif
+#ifndef FRAM_TS_BLOCK_MAX
+#define FRAM_TS_BLOCK_MAX 128
+#endif
+
+#define FRAM_TS_HEADER_SIZE 14
+#define FRAM_TS_SAMPLE_MAX 10		// 2 x 5 bytes varints
+#define FRAM_TS_UNUSED 0xFFFF
+#define FRAM_TS_NO_BLOCK 0xFF
+
+typedef struct {
+	uint16_t	seq;
+	uint16_t	count;
+	uint16_t	bytes;
+	uint32_t	firstTs;
+	uint32_t	lastTs;
+} __attribute__((packed)) FramTSHeader;
+
+
+class FramTimeSeries {
+ public:
+	FramTimeSeries(FRAM_MB85RC_I2C *fram, uint16_t baseAddr, uint16_t size, uint8_t blockSize);
+
+	byte	begin(void);
+	byte	format(void);
+	byte	append(uint32_t timestamp, int32_t value);
+	byte	query(uint32_t t1, uint32_t t2, uint32_t timestamps[], int32_t values[], uint16_t maxSamples, uint16_t *found, uint16_t skip = 0);
+
+	uint32_t	firstTimestamp(void);
+	uint32_t	lastTimestamp(void);
+	uint8_t		blockCount(void);
+	uint8_t		usedBlocks(void);
+
+ private:
+	FRAM_MB85RC_I2C	*_fram;
+	uint16_t	_base;
+	uint8_t		_blockSize;
+	uint8_t		_blockCount;
+
+	// RAM index, by physical block
+	uint32_t	_firstTs[FRAM_TS_MAX_BLOCKS];
+	uint8_t		_bytes[FRAM_TS_MAX_BLOCKS];
+
+	uint8_t		_newest;
+	uint8_t		_used;
+	uint16_t	_seq;
+	uint16_t	_count;			// newest block state
+	uint32_t	_lastTs;
+	int32_t		_lastValue;
+	uint8_t		_buf[FRAM_TS_BLOCK_MAX];
+
+	uint16_t	blockAddress(uint8_t block);
+	uint8_t		physical(uint8_t logical);
+	byte		openBlock(uint32_t timestamp);
+	byte		loadBlock(uint8_t block, FramTSHeader *header);
+	static uint8_t	putVarint(uint8_t buf[], uint32_t value);
+	static uint8_t	getVarint(const uint8_t buf[], uint8_t len, uint32_t *value);
+};
+
+#endif
@@ -0,0 +1,180 @@
+/**************************************************************************/
+/*!
+    @file     FRAM_I2C_benchmark.ino
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Benchmark sketch measuring each public operation of the lib.
+	Runs every operation over several transfer sizes and I2C bus clocks and
+	prints one line per measure to Serial, CSV or JSON (BENCH_JSON), ready
+	to be diffed between two lib versions. Operations not fitting the chip
+	from BENCH_ADDRESS are skipped.
+
+	The same sketch runs on the host over a simulated bus, for each density :
+	see extras/host/Makefile (make bench). Bus times are simulated there, the
+	results are reproducible and show changes of the bus traffic.
+
+	WARNING : the benchmark overwrites the memory from BENCH_ADDRESS.
+	Set SERIAL_DEBUG to 0 in FRAM_MB85RC_I2C.h, the debug output would be measured too.
+
+    @section  HISTORY
+
+    v1.0.0 - First release
+    v1.1.0 - JSON output, scratch walk kept within the chip, host build
+*/
+/**************************************************************************/
+
+#include <Wire.h>
+#include <FRAM_MB85RC_I2C.h>
+
+#define BENCH_ADDRESS 0x0000	// scratch area start
+#define BENCH_ITERATIONS 100	// calls per measure
+#define BENCH_ERASE false		// eraseDevice() takes seconds on large chips - enable when needed
+#ifndef BENCH_JSON
+#define BENCH_JSON false		// true : one JSON object per measure in an array, false : CSV
+#endif
+#ifndef BENCH_MANUAL_DENSITY
+#define BENCH_MANUAL_DENSITY 0	// chips without device IDs (MB85RC16...) : their density in Kbit
+#endif
+
+//Bus clocks to test - drop the ones your board or chip does not support
+const uint32_t clocks[] = { 100000, 400000, 1000000 };
+//Transfer sizes for readArray() & writeArray()
+const byte sizes[] = { 1, 2, 4, 8, 16, FRAM_BURST_SIZE };
+
+enum benchOp {
+	OP_READARRAY, OP_WRITEARRAY, OP_READBYTE, OP_WRITEBYTE, OP_COPYBYTE,
+	OP_READWORD, OP_WRITEWORD, OP_READLONG, OP_WRITELONG,
+	OP_READBIT, OP_SETBIT, OP_CLEARBIT, OP_TOGGLEBIT, OP_ERASE
+};
+const char *opNames[] = {
+	"readArray", "writeArray", "readByte", "writeByte", "copyByte",
+	"readWord", "writeWord", "readLong", "writeLong",
+	"readBit", "setOneBit", "clearOneBit", "toggleBit", "eraseDevice"
+};
+const byte opSizes[] = { 0, 0, 1, 1, 1, 2, 2, 4, 4, 1, 1, 1, 1, 0 };
+
+uint8_t buffer[FRAM_BURST_SIZE];
+uint16_t density;
+uint16_t lastAddress;	// last address of the chip as seen by the lib
+boolean firstMeasure = true;
+
+//Creating object for FRAM chip
+#if BENCH_MANUAL_DENSITY
+FRAM_MB85RC_I2C mymemory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS, DEFAULT_WP_PIN, BENCH_MANUAL_DENSITY);
+#else
+FRAM_MB85RC_I2C mymemory;
+#endif
+
+
+byte runOp(byte op, byte size, uint16_t address) {
+	uint8_t b;
+	uint16_t w;
+	uint32_t l;
+	switch (op) {
+		case OP_READARRAY:	return mymemory.readArray(address, size, buffer);
+		case OP_WRITEARRAY:	return mymemory.writeArray(address, size, buffer);
+		case OP_READBYTE:	return mymemory.readByte(address, &b);
+		case OP_WRITEBYTE:	return mymemory.writeByte(address, 0x5A);
+		case OP_COPYBYTE:	return mymemory.copyByte(address, address + 1);
+		case OP_READWORD:	return mymemory.readWord(address, &w);
+		case OP_WRITEWORD:	return mymemory.writeWord(address, 0xBEEF);
+		case OP_READLONG:	return mymemory.readLong(address, &l);
+		case OP_WRITELONG:	return mymemory.writeLong(address, 0xDEADBEEF);
+		case OP_READBIT:	return mymemory.readBit(address, 3, &b);
+		case OP_SETBIT:		return mymemory.setOneBit(address, 3);
+		case OP_CLEARBIT:	return mymemory.clearOneBit(address, 3);
+		case OP_TOGGLEBIT:	return mymemory.toggleBit(address, 3);
+		case OP_ERASE:		return mymemory.eraseDevice();
+	}
+	return ERROR_10;
+}
+
+void measure(byte op, byte size, uint32_t clock) {
+	uint16_t iterations = (op == OP_ERASE) ? 1 : BENCH_ITERATIONS;
+	uint16_t errors = 0;
+	uint16_t address = BENCH_ADDRESS;
+
+	// bytes touched per call : copyByte() reads the next byte too
+	byte span = (op == OP_COPYBYTE) ? 2 : size;
+	// scratch walk of up to 64 bursts, within the chip
+	uint32_t walkEnd = (uint32_t)BENCH_ADDRESS + 64 * FRAM_BURST_SIZE;
+	if (walkEnd > (uint32_t)lastAddress + 1) walkEnd = (uint32_t)lastAddress + 1;
+	if ((op != OP_ERASE) && ((uint32_t)BENCH_ADDRESS + span > walkEnd)) return;
+
+	unsigned long start = micros();
+	for (uint16_t i = 0; i < iterations; i++) {
+		if (runOp(op, size, address) != 0) errors++;
+		address += FRAM_BURST_SIZE; // walk the scratch area, defeats any caching
+		if ((uint32_t)address + span > walkEnd) address = BENCH_ADDRESS;
+	}
+	unsigned long elapsed = micros() - start;
+
+	uint32_t bytes = (op == OP_ERASE) ? (uint32_t)density * 128 : (uint32_t)size * iterations;
+	float usPerOp = (float)elapsed / iterations;
+	float bytesPerSec = (elapsed > 0) ? (float)bytes * 1000000.0 / elapsed : 0;
+
+#if BENCH_JSON
+	Serial.print(firstMeasure ? "[\n" : ",\n");
+	Serial.print("{\"op\":\""); Serial.print(opNames[op]);
+	Serial.print("\",\"density_kbit\":"); Serial.print(density, DEC);
+	Serial.print(",\"clock_hz\":"); Serial.print(clock, DEC);
+	Serial.print(",\"size\":"); Serial.print(size, DEC);
+	Serial.print(",\"iterations\":"); Serial.print(iterations, DEC);
+	Serial.print(",\"errors\":"); Serial.print(errors, DEC);
+	Serial.print(",\"us_per_op\":"); Serial.print(usPerOp, 2);
+	Serial.print(",\"bytes_per_s\":"); Serial.print(bytesPerSec, 0);
+	Serial.print("}");
+#else
+	// op,density_kbit,clock_hz,size,iterations,errors,us_per_op,bytes_per_s
+	Serial.print(opNames[op]); Serial.print(',');
+	Serial.print(density, DEC); Serial.print(',');
+	Serial.print(clock, DEC); Serial.print(',');
+	Serial.print(size, DEC); Serial.print(',');
+	Serial.print(iterations, DEC); Serial.print(',');
+	Serial.print(errors, DEC); Serial.print(',');
+	Serial.print(usPerOp, 2); Serial.print(',');
+	Serial.println(bytesPerSec, 0);
+#endif
+	firstMeasure = false;
+}
+
+void setup() {
+
+	Serial.begin(115200);
+	while (!Serial) ; //wait until Serial ready
+	Wire.begin();
+
+	mymemory.begin();
+	mymemory.getOneDeviceID(4, &density);
+	lastAddress = (density >= 512) ? 0xFFFF : (uint16_t)(density * 128 - 1); // 1M parts : one half per instance
+
+	for (byte i = 0; i < FRAM_BURST_SIZE; i++) buffer[i] = i;
+
+#if !BENCH_JSON
+	Serial.println("op,density_kbit,clock_hz,size,iterations,errors,us_per_op,bytes_per_s");
+#endif
+
+	for (byte c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++) {
+		Wire.setClock(clocks[c]);
+		for (byte s = 0; s < sizeof(sizes); s++) {
+			measure(OP_READARRAY, sizes[s], clocks[c]);
+			measure(OP_WRITEARRAY, sizes[s], clocks[c]);
+		}
+		for (byte op = OP_READBYTE; op < OP_ERASE; op++) {
+			measure(op, opSizes[op], clocks[c]);
+		}
+		if (BENCH_ERASE) measure(OP_ERASE, 0, clocks[c]);
+	}
+	Wire.setClock(100000);
+
+#if BENCH_JSON
+	Serial.println(firstMeasure ? "[]" : "\n]");
+#else
+	Serial.println("# benchmark done");
+#endif
+}
+
+void loop() {
+	// nothing to do
+}
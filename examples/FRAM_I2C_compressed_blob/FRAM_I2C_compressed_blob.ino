@@ -0,0 +1,70 @@
+/**************************************************************************/
+/*!
+    @file     FRAM_I2C_compressed_blob.ino
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Example sketch that stores a text record compressed and streams it back.
+	Neither the writer nor the reader holds the whole blob in RAM.
+
+    @section  HISTORY
+
+    v1.0.0 - First release
+*/
+/**************************************************************************/
+
+#include <Wire.h>
+#include <FRAM_MB85RC_I2C.h>
+#include <FramBlob.h>
+
+
+//Blob region : 2048 bytes from address 0x100
+uint16_t blobaddress = 0x100;
+uint16_t blobsize = 2048;
+
+//Creating object for FRAM chip
+FRAM_MB85RC_I2C mymemory;
+FramBlob myblob(&mymemory, blobaddress, blobsize);
+
+void setup() {
+
+	Serial.begin(115200);
+	while (!Serial) ; //wait until Serial ready
+	Wire.begin();
+
+    Serial.println("Starting...");
+
+	mymemory.begin();
+
+//---------write a repetitive record chunk by chunk
+	const char line[] = "{\"sensor\":\"temp\",\"unit\":\"C\",\"value\":21.5}\n";
+	byte result = myblob.beginWrite();
+	for (byte i = 0; (i < 20) && (result == 0); i++) {
+		result = myblob.write((const uint8_t *)line, sizeof(line) - 1);
+	}
+	if (result == 0) result = myblob.endWrite();
+
+	if (result == 0) Serial.println("Write Done");
+	if (result != 0) Serial.println("Write failed");
+	Serial.print("Raw size: ");
+	Serial.println(myblob.rawLength(), DEC);
+	Serial.print("Stored size: ");
+	Serial.println(myblob.storedLength(), DEC);
+	Serial.println("...... ...... ......");
+
+//---------stream it back
+	uint16_t rawlength, got;
+	uint8_t chunk[16];
+	result = myblob.beginRead(&rawlength);
+	do {
+		result = myblob.read(chunk, sizeof(chunk), &got);
+		Serial.write(chunk, got);
+	} while ((result == 0) && (got > 0));
+
+	Serial.println("...... ...... ......");
+	Serial.println("Blob read done");
+}
+
+void loop() {
+	// nothing to do
+}
@@ -0,0 +1,61 @@
+/**************************************************************************/
+/*!
+    @file     FRAM_I2C_stream_log.ino
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Example sketch printing log lines straight to FRAM with FramStream,
+	then dumping them back to Serial.
+
+    @section  HISTORY
+
+    v1.0.0 - First release
+*/
+/**************************************************************************/
+
+#include <Wire.h>
+#include <FRAM_MB85RC_I2C.h>
+#include <FramStream.h>
+
+
+//Log region : 4096 bytes from address 0x200
+FRAM_MB85RC_I2C mymemory;
+FramStream mylog(&mymemory, 0x200, 4096);
+
+void setup() {
+
+	Serial.begin(115200);
+	while (!Serial) ; //wait until Serial ready
+	Wire.begin();
+
+    Serial.println("Starting...");
+
+	mymemory.begin();
+
+//---------log some lines, no RAM staging buffer
+	for (byte i = 0; i < 10; i++) {
+		mylog.print("t=");
+		mylog.print(millis(), DEC);
+		mylog.print(" sample #");
+		mylog.println(i, DEC);
+	}
+	mylog.flush();
+
+	Serial.print("Log length: ");
+	Serial.println(mylog.length(), DEC);
+	Serial.println("...... ...... ......");
+
+//---------dump the log
+	char line[64];
+	mylog.seekRead(0);
+	while (mylog.available()) {
+		size_t n = mylog.readBytesUntil('\n', line, sizeof(line) - 1);
+		line[n] = 0;
+		Serial.println(line);
+	}
+	Serial.println("...... ...... ......");
+}
+
+void loop() {
+	// nothing to do
+}
@@ -0,0 +1,115 @@
+/**************************************************************************/
+/*!
+    @file     Arduino.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host build of the lib : the part of the Arduino core the lib & examples
+    use. Time is simulated, see FakeFram.h.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_HOST_ARDUINO_H_
+#define _FRAM_HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+#define F(string) (string)
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+
+void noInterrupts(void);
+void interrupts(void);
+
+class Print {
+ public:
+	Print() : _writeError(0) {}
+	virtual ~Print() {}
+
+	virtual size_t	write(uint8_t c) = 0;
+	virtual size_t	write(const uint8_t *buffer, size_t size);
+	size_t	write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+	virtual int	availableForWrite(void) { return 0; }
+	virtual void	flush(void) {}
+
+	int		getWriteError(void) { return _writeError; }
+	void	clearWriteError(void) { _writeError = 0; }
+
+	size_t	print(const char str[]);
+	size_t	print(char c);
+	size_t	print(int n, int base = DEC);
+	size_t	print(unsigned int n, int base = DEC);
+	size_t	print(long n, int base = DEC);
+	size_t	print(unsigned long n, int base = DEC);
+	size_t	print(double n, int digits = 2);
+
+	size_t	println(void);
+	size_t	println(const char str[]);
+	size_t	println(char c);
+	size_t	println(int n, int base = DEC);
+	size_t	println(unsigned int n, int base = DEC);
+	size_t	println(long n, int base = DEC);
+	size_t	println(unsigned long n, int base = DEC);
+	size_t	println(double n, int digits = 2);
+
+ protected:
+	void	setWriteError(int err = 1) { _writeError = err; }
+
+ private:
+	int		_writeError;
+};
+
+class Stream : public Print {
+ public:
+	virtual int	available(void) = 0;
+	virtual int	read(void) = 0;
+	virtual int	peek(void) = 0;
+
+	void	setTimeout(unsigned long timeout) { (void)timeout; }
+	size_t	readBytes(char *buffer, size_t length);
+	size_t	readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+	size_t	readBytesUntil(char terminator, char *buffer, size_t length);
+};
+
+// Serial : stdout, nothing to read
+class HardwareSerial : public Stream {
+ public:
+	using Print::write;
+	void	begin(unsigned long baud) { (void)baud; }
+	operator bool() { return true; }
+	size_t	write(uint8_t c);
+	int		available(void) { return 0; }
+	int		read(void) { return -1; }
+	int		peek(void) { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
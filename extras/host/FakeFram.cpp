@@ -0,0 +1,354 @@
+/**************************************************************************/
+/*!
+    @file     FakeFram.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host build of the lib : Arduino core subset, simulated bus & chips.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FakeFram.h"
+
+#define FAKE_MASTER_CODE 0x7C	// 0xF8 >> 1, device ID & sleep commands
+
+/*========================================================================*/
+/*                             SIMULATED TIME                             */
+/*========================================================================*/
+
+static std::atomic<uint64_t> fakeNanos(0);
+
+static void fakeAdvance(uint64_t nanos) {
+	fakeNanos += nanos;
+}
+
+unsigned long micros(void) { return (unsigned long)(fakeNanos / 1000); }
+unsigned long millis(void) { return (unsigned long)(fakeNanos / 1000000); }
+void delay(unsigned long ms) { fakeAdvance((uint64_t)ms * 1000000); }
+void delayMicroseconds(unsigned int us) { fakeAdvance((uint64_t)us * 1000); }
+void yield(void) { std::this_thread::yield(); }
+
+void pinMode(int pin, int mode) { (void)pin; (void)mode; }
+void digitalWrite(int pin, int value) { (void)pin; (void)value; }
+
+// Single core board : one global critical section
+static std::recursive_mutex fakeInterrupts;
+void noInterrupts(void) { fakeInterrupts.lock(); }
+void interrupts(void) { fakeInterrupts.unlock(); }
+
+/*========================================================================*/
+/*                              PRINT & STREAM                            */
+/*========================================================================*/
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while ((n < size) && (write(buffer[n]) == 1)) n++;
+	return n;
+}
+
+static size_t printFormat(Print *out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static size_t printFormat(Print *out, const char *format, ...) {
+	char text[64];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	if (n < 0) return 0;
+	return out->write((const uint8_t *)text, (n < (int)sizeof(text)) ? n : sizeof(text) - 1);
+}
+
+size_t Print::print(const char str[]) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(int n, int base) { return print((long)n, base); }
+size_t Print::print(unsigned int n, int base) { return print((unsigned long)n, base); }
+size_t Print::print(long n, int base) { return (base == HEX) ? printFormat(this, "%lX", (unsigned long)n) : printFormat(this, "%ld", n); }
+size_t Print::print(unsigned long n, int base) { return printFormat(this, (base == HEX) ? "%lX" : "%lu", n); }
+size_t Print::print(double n, int digits) { return printFormat(this, "%.*f", digits, n); }
+
+size_t Print::println(void) { return write("\r\n"); }
+size_t Print::println(const char str[]) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+	size_t n = 0;
+	while (n < length) {
+		int c = read();
+		if (c < 0) break;
+		buffer[n++] = (char)c;
+	}
+	return n;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+	size_t n = 0;
+	while (n < length) {
+		int c = read();
+		if ((c < 0) || (c == terminator)) break;
+		buffer[n++] = (char)c;
+	}
+	return n;
+}
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) {
+	if (c != '\r') putchar(c);
+	return 1;
+}
+
+/*========================================================================*/
+/*                                FAKE BUS                                */
+/*========================================================================*/
+
+class FakeBus {
+ public:
+	FakeBus() : clock(100000), open(false), idTarget(0), txAddress(0), txCount(0), rxCount(0), rxIndex(0),
+		transfers(0), bytes(0), collisions(0) {}
+
+	std::mutex	mutex;			// keeps the simulation consistent, not the transactions
+	std::vector<FakeFram *>	chips;
+	uint32_t	clock;
+
+	// transaction in progress
+	boolean		open;
+	std::thread::id	owner;
+	uint8_t		idTarget;		// device address sent after the master code
+	uint8_t		txAddress;
+	uint8_t		txBuffer[BUFFER_LENGTH];
+	uint8_t		txCount;
+	uint8_t		rxBuffer[BUFFER_LENGTH];
+	uint8_t		rxCount;
+	uint8_t		rxIndex;
+
+	uint32_t	transfers;
+	uint32_t	bytes;
+	uint32_t	collisions;
+
+	// called with the mutex held, by every access
+	void access(void) {
+		std::thread::id self = std::this_thread::get_id();
+		if (open && (owner != self)) collisions++;
+		open = true;
+		owner = self;
+	}
+
+	void clockBits(uint32_t bits) {
+		fakeAdvance((uint64_t)bits * 1000000000ULL / clock);
+	}
+
+	FakeFram *find(uint8_t address) {
+		for (size_t i = 0; i < chips.size(); i++) {
+			if ((address & chips[i]->_addressMask) == chips[i]->_address) return chips[i];
+		}
+		return NULL;
+	}
+};
+
+FakeFram::FakeFram(TwoWire *wire, uint8_t address, uint16_t density, boolean deviceIDs, uint16_t manufacturer)
+{
+	uint8_t densityCode;
+	switch (density) {
+		case 4:		densityCode = 0x0; _addressMask = 0xFE; break;
+		case 16:	densityCode = 0x0; _addressMask = 0xF8; deviceIDs = false; break;	// MB85RC16 : no IDs
+		case 64:	densityCode = 0x3; _addressMask = 0xFF; break;
+		case 128:	densityCode = 0x1; _addressMask = 0xFF; manufacturer = FAKE_FRAM_CYPRESS; break;
+		case 256:	densityCode = (manufacturer == FAKE_FRAM_CYPRESS) ? 0x2 : 0x5; _addressMask = 0xFF; break;
+		case 512:	densityCode = (manufacturer == FAKE_FRAM_CYPRESS) ? 0x3 : 0x6; _addressMask = 0xFF; break;
+		default:	density = 1024; densityCode = (manufacturer == FAKE_FRAM_CYPRESS) ? 0x4 : 0x7; _addressMask = 0xFE; break;
+	}
+	_bus = wire->bus();
+	_address = address & _addressMask;
+	_density = density;
+	_deviceIDs = deviceIDs;
+	_ids[0] = (uint8_t)(manufacturer >> 4);
+	_ids[1] = (uint8_t)(((manufacturer & 0x0F) << 4) | densityCode);
+	_ids[2] = 0x10;
+	_size = (uint32_t)density * 128;
+	_memory = new uint8_t[_size];
+	memset(_memory, 0, _size);
+	_latch = 0;
+
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	_bus->chips.push_back(this);
+}
+
+FakeFram::~FakeFram()
+{
+	{
+		std::lock_guard<std::mutex> guard(_bus->mutex);
+		for (size_t i = 0; i < _bus->chips.size(); i++) {
+			if (_bus->chips[i] == this) _bus->chips.erase(_bus->chips.begin() + i);
+		}
+	}
+	delete[] _memory;
+}
+
+/*========================================================================*/
+/*                                 TWOWIRE                                */
+/*========================================================================*/
+
+TwoWire Wire;
+TwoWire Wire1;
+
+TwoWire::TwoWire(void)
+{
+	_bus = new FakeBus();
+}
+
+void TwoWire::setClock(uint32_t clock) {
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	if (clock > 0) _bus->clock = clock;
+}
+
+// A real transfer takes time : other threads get the CPU at the start of each one
+void TwoWire::beginTransmission(uint8_t address) {
+	std::this_thread::yield();
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	_bus->access();
+	_bus->txAddress = address;
+	_bus->txCount = 0;
+}
+
+size_t TwoWire::write(uint8_t c) {
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	_bus->access();
+	if (_bus->txCount >= BUFFER_LENGTH) {
+		setWriteError();
+		return 0;
+	}
+	_bus->txBuffer[_bus->txCount++] = c;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buffer, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		if (TwoWire::write(buffer[i]) == 0) return i;
+	}
+	return size;
+}
+
+// returns 0 : ok, 2 : address not acknowledged, as the AVR core
+uint8_t TwoWire::endTransmission(bool sendStop) {
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	FakeBus *bus = _bus;
+	bus->access();
+	bus->transfers++;
+	bus->bytes += bus->txCount;
+	bus->clockBits(2 + 9 * (1 + bus->txCount));
+	if (sendStop) bus->open = false;
+
+	if (bus->txAddress == FAKE_MASTER_CODE) {
+		if (bus->txCount > 0) bus->idTarget = bus->txBuffer[0] >> 1;
+		FakeFram *chip = bus->find(bus->idTarget);
+		return ((chip != NULL) && chip->_deviceIDs) ? 0 : 2;
+	}
+
+	FakeFram *chip = bus->find(bus->txAddress);
+	if (chip == NULL) return 2;
+
+	uint8_t addressBytes = (chip->_density < 64) ? 1 : 2;
+	if (bus->txCount < addressBytes) return 0;
+
+	uint32_t page = bus->txAddress & ~chip->_addressMask;
+	uint32_t latch = (addressBytes == 1) ? ((page << 8) | bus->txBuffer[0]) : ((page << 16) | (bus->txBuffer[0] << 8) | bus->txBuffer[1]);
+	for (uint8_t i = addressBytes; i < bus->txCount; i++) {
+		chip->_memory[latch % chip->_size] = bus->txBuffer[i];
+		latch++;
+	}
+	chip->_latch = latch % chip->_size;
+	chip->_latchOwner = std::this_thread::get_id();
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+	std::this_thread::yield();
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	FakeBus *bus = _bus;
+	bus->access();
+	if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+	bus->rxCount = 0;
+	bus->rxIndex = 0;
+
+	FakeFram *chip = bus->find((address == FAKE_MASTER_CODE) ? bus->idTarget : address);
+	if ((chip != NULL) && (address == FAKE_MASTER_CODE) && !chip->_deviceIDs) chip = NULL;
+	if (chip != NULL) {
+		for (uint8_t i = 0; i < quantity; i++) {
+			if (address == FAKE_MASTER_CODE) {
+				bus->rxBuffer[i] = chip->_ids[i % 3];
+			}
+			else {
+				if ((i == 0) && (chip->_latchOwner != std::thread::id()) && (chip->_latchOwner != std::this_thread::get_id())) bus->collisions++;
+				bus->rxBuffer[i] = chip->_memory[chip->_latch];
+				chip->_latch = (chip->_latch + 1) % chip->_size;
+			}
+		}
+		bus->rxCount = quantity;
+	}
+
+	bus->transfers++;
+	bus->bytes += bus->rxCount;
+	bus->clockBits(2 + 9 * (1 + quantity));
+	if (bus->rxCount == 0) bus->open = false;
+	return bus->rxCount;
+}
+
+int TwoWire::available(void) {
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	return _bus->rxCount - _bus->rxIndex;
+}
+
+int TwoWire::read(void) {
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	FakeBus *bus = _bus;
+	if (bus->rxIndex >= bus->rxCount) return -1;
+	bus->access();
+	int c = bus->rxBuffer[bus->rxIndex++];
+	if (bus->rxIndex == bus->rxCount) bus->open = false;	// stop sent after the last byte
+	return c;
+}
+
+int TwoWire::peek(void) {
+	std::lock_guard<std::mutex> guard(_bus->mutex);
+	return (_bus->rxIndex < _bus->rxCount) ? _bus->rxBuffer[_bus->rxIndex] : -1;
+}
+
+/*========================================================================*/
+/*                             BUS STATISTICS                             */
+/*========================================================================*/
+
+uint32_t fakeBusTransfers(TwoWire *wire) {
+	std::lock_guard<std::mutex> guard(wire->bus()->mutex);
+	return wire->bus()->transfers;
+}
+
+uint32_t fakeBusBytes(TwoWire *wire) {
+	std::lock_guard<std::mutex> guard(wire->bus()->mutex);
+	return wire->bus()->bytes;
+}
+
+uint32_t fakeBusCollisions(TwoWire *wire) {
+	std::lock_guard<std::mutex> guard(wire->bus()->mutex);
+	return wire->bus()->collisions;
+}
+
+void fakeBusClearStats(TwoWire *wire) {
+	std::lock_guard<std::mutex> guard(wire->bus()->mutex);
+	wire->bus()->transfers = 0;
+	wire->bus()->bytes = 0;
+	wire->bus()->collisions = 0;
+}
@@ -0,0 +1,75 @@
+/**************************************************************************/
+/*!
+    @file     FakeFram.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host build of the lib : simulated FRAM chips on a simulated I2C bus, for
+    the host benchmark & the tests of extras/host (see the Makefile there).
+
+    A chip answers to its device address, or to 2 / 8 of them for 4K / 16K
+    parts which take the upper memory address bits there, and to the device
+    ID command when built with IDs. It has an address latch like the real
+    parts : a read without address phase continues after the last access.
+
+    Time is simulated : micros() moves on with the bits clocked on the bus at
+    the clock set by setClock() (9 bits per byte, 2 for start & stop) and
+    with delay() / delayMicroseconds(), so bus times are reproducible from
+    one run to the next. The CPU time of the lib is not counted.
+
+    Each bus counts the transfers, the bytes, and the collisions : accesses
+    from a thread while the transaction of another thread is open, and reads
+    from the address latch another thread moved - the interleaving a missing
+    bus lock lets through.
+
+    Create the chips in main(), after the TwoWire objects are constructed.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_HOST_FAKE_FRAM_H_
+#define _FRAM_HOST_FAKE_FRAM_H_
+
+#include <thread>
+#include "Arduino.h"
+#include "Wire.h"
+
+#define FAKE_FRAM_FUJITSU 0x00A
+#define FAKE_FRAM_CYPRESS 0x004
+
+class FakeFram {
+ public:
+	FakeFram(TwoWire *wire, uint8_t address, uint16_t density, boolean deviceIDs = true, uint16_t manufacturer = FAKE_FRAM_FUJITSU);
+	~FakeFram();
+
+	uint8_t		*memory(void) { return _memory; }
+	uint32_t	size(void) { return _size; }
+
+ private:
+	friend class FakeBus;
+	friend class TwoWire;
+
+	FakeBus		*_bus;
+	uint8_t		_address;
+	uint8_t		_addressMask;	// device address bits matched
+	uint16_t	_density;
+	boolean		_deviceIDs;
+	uint8_t		_ids[3];
+	uint8_t		*_memory;
+	uint32_t	_size;
+	uint32_t	_latch;
+	std::thread::id	_latchOwner;	// thread of the last address phase
+
+	FakeFram(const FakeFram &);
+	FakeFram &operator=(const FakeFram &);
+};
+
+// Bus statistics
+uint32_t	fakeBusTransfers(TwoWire *wire);
+uint32_t	fakeBusBytes(TwoWire *wire);
+uint32_t	fakeBusCollisions(TwoWire *wire);
+void		fakeBusClearStats(TwoWire *wire);
+
+#endif
@@ -0,0 +1,60 @@
+/**************************************************************************/
+/*!
+    @file     Wire.h
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host build of the lib : TwoWire API over a simulated bus, the chips on
+    it are FakeFram objects (see FakeFram.h). The buffer length follows the
+    AVR core, build with -DBUFFER_LENGTH=128 to get ESP32 bursts.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+#ifndef _FRAM_HOST_WIRE_H_
+#define _FRAM_HOST_WIRE_H_
+
+#include "Arduino.h"
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32
+#endif
+
+class FakeBus;
+
+class TwoWire : public Stream {
+ public:
+	TwoWire(void);
+
+	void	begin(void) {}
+	void	setClock(uint32_t clock);
+
+	void	beginTransmission(uint8_t address);
+	void	beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	uint8_t	endTransmission(bool sendStop = true);
+	uint8_t	requestFrom(uint8_t address, uint8_t quantity);
+	uint8_t	requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+
+	using Print::write;
+	size_t	write(uint8_t c);
+	size_t	write(const uint8_t *buffer, size_t size);
+	size_t	write(int n) { return write((uint8_t)n); }
+	size_t	write(unsigned int n) { return write((uint8_t)n); }
+	size_t	write(long n) { return write((uint8_t)n); }
+	size_t	write(unsigned long n) { return write((uint8_t)n); }
+	int		available(void);
+	int		read(void);
+	int		peek(void);
+
+	FakeBus	*bus(void) { return _bus; }
+
+ private:
+	FakeBus	*_bus;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,33 @@
+/**************************************************************************/
+/*!
+    @file     bench_main.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host build of examples/FRAM_I2C_benchmark : the sketch runs once against
+    a simulated chip of FAKE_DENSITY Kbit, see the Makefile.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include "FakeFram.h"
+
+#ifndef FAKE_DENSITY
+#define FAKE_DENSITY 256
+#endif
+
+#if FAKE_DENSITY == 16
+ #define BENCH_MANUAL_DENSITY 16	// no device IDs on 16K parts
+#endif
+
+#include "../../examples/FRAM_I2C_benchmark/FRAM_I2C_benchmark.ino"
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, FAKE_DENSITY);
+	setup();
+	return 0;
+}
@@ -0,0 +1,114 @@
+/**************************************************************************/
+/*!
+    @file     test_btree.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of FramBTree in a full region : the tree is filled until
+    insert() reports the region full, with ascending then random keys, for
+    a range of region sizes so the last split lands on every level.
+    Passes when nothing was written outside the region, every key inserted
+    is found, and the tree reloads from FRAM.
+
+    The nodes used by 10k ascending keys are printed last, to size a region
+    (make test BUFFER_LENGTH=128 for ESP32 nodes).
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+#include "FramBTree.h"
+
+#define REGION 0x0100
+#define NODES_MIN 2
+#define NODES_MAX 80
+#define GUARD 0xA5
+#define MAX_KEYS 4000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static FramBTreeKey keys[MAX_KEYS];
+
+static uint32_t guardsChanged(FakeFram *chip, uint16_t size) {
+	uint32_t changed = 0;
+	for (uint32_t i = 0; i < chip->size(); i++) {
+		if ((i >= REGION) && (i < (uint32_t)REGION + size)) continue;
+		if (chip->memory()[i] != GUARD) changed++;
+	}
+	return changed;
+}
+
+// Inserts until the region is full, then checks the region bounds and the content.
+// The region is one byte short of one more node.
+static uint16_t fill(FakeFram *chip, FRAM_MB85RC_I2C *fram, boolean ascending, uint16_t nodes) {
+	const char *order = ascending ? "ascending" : "random";
+	uint16_t size = FRAM_BTREE_HEADER_SIZE + nodes * FRAM_BTREE_NODE_SIZE + FRAM_BTREE_NODE_SIZE - 1;
+	memset(chip->memory(), GUARD, chip->size());
+
+	FramBTree tree(fram, REGION, size);
+	CHECK(tree.format() == ERROR_0, "%s : format() failed", order);
+
+	unsigned int seed = 7;
+	uint16_t count = 0;
+	byte result = ERROR_0;
+	while (count < MAX_KEYS) {
+		FramBTreeKey key = ascending ? (FramBTreeKey)(count * 3 + 1) : (FramBTreeKey)rand_r(&seed);
+		result = tree.insert(key, (FramBTreeValue)key);
+		if (result != ERROR_0) break;
+		if (tree.entries() > count) keys[count++] = key;	// random keys may repeat
+	}
+	CHECK(result == ERROR_11, "%s, %u nodes : insert() returned %d, region full expected", order, nodes, result);
+	CHECK(tree.nodesUsed() <= tree.capacity(), "%s, %u nodes : %u nodes used", order, nodes, tree.nodesUsed());
+	uint32_t outside = guardsChanged(chip, size);
+	CHECK(outside == 0, "%s, %u nodes : %u bytes written outside the region", order, nodes, outside);
+
+	// the failed insert left the tree unchanged, removal makes room in that leaf again
+	CHECK(tree.entries() == count, "%s, %u nodes : %u entries, %u expected", order, nodes, tree.entries(), count);
+	CHECK(tree.remove(keys[0]) == ERROR_0, "%s, %u nodes : remove() failed", order, nodes);
+	CHECK(tree.insert(keys[0], (FramBTreeValue)keys[0]) == ERROR_0, "%s, %u nodes : insert() after remove() failed", order, nodes);
+
+	FramBTree reloaded(fram, REGION, size);
+	CHECK(reloaded.begin() == ERROR_0, "%s, %u nodes : begin() failed", order, nodes);
+	uint16_t missing = 0;
+	for (uint16_t i = 0; i < count; i++) {
+		FramBTreeValue value;
+		if ((reloaded.find(keys[i], &value) != ERROR_0) || (value != (FramBTreeValue)keys[i])) missing++;
+	}
+	CHECK(missing == 0, "%s, %u nodes : %u keys not found", order, nodes, missing);
+	return count;
+}
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, 512);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	Wire.setClock(400000);
+	memory.begin();
+	CHECK(memory.isReady(), "chip not found");
+
+	for (uint16_t nodes = NODES_MIN; nodes <= NODES_MAX; nodes++) {
+		uint16_t ascending = fill(&chip, &memory, true, nodes);
+		uint16_t random = fill(&chip, &memory, false, nodes);
+		if (nodes == NODES_MAX) printf("%u nodes full : %u ascending keys, %u random keys\n", nodes, ascending, random);
+	}
+
+	// sizing, not checked : 10k ascending keys
+	memset(chip.memory(), GUARD, chip.size());
+	FramBTree tree(&memory, 0, 0xFFFF);
+	CHECK(tree.format() == ERROR_0, "format() failed");
+	uint16_t count = 0;
+	while ((count < 10000) && (tree.insert(count, count) == ERROR_0)) count++;
+	printf("%u ascending keys, %u bytes nodes, %u bytes keys : %u nodes, %lu bytes, height %u\n", count, FRAM_BTREE_NODE_SIZE,
+		(unsigned int)sizeof(FramBTreeKey), tree.nodesUsed(), (unsigned long)FRAM_BTREE_HEADER_SIZE + (unsigned long)tree.nodesUsed() * FRAM_BTREE_NODE_SIZE, tree.height());
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
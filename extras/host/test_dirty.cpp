@@ -0,0 +1,150 @@
+/**************************************************************************/
+/*!
+    @file     test_dirty.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of the dirty ranges export (exportDirty()) : the stream is
+    parsed as a receiver would, for a complete export and for exports cut
+    by the chip leaving the bus while the stream is written.
+    Passes when the receiver gets every range exported with its content,
+    detects the failing range from the end record, and the ranges not
+    received stay dirty for the next export.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include <vector>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+
+#if FRAM_DIRTY_MAX < 8
+ #error "build with -DFRAM_DIRTY_MAX=8"
+#endif
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+// Keeps the stream, removes the chip from the bus once cutAfter bytes are written
+class Capture : public Print {
+ public:
+	std::vector<uint8_t>	bytes;
+	size_t		cutAfter;
+	FakeFram	**chip;
+
+	Capture(FakeFram **c, size_t cut) : cutAfter(cut), chip(c) {}
+	size_t write(uint8_t c) {
+		bytes.push_back(c);
+		if ((bytes.size() >= cutAfter) && (*chip != NULL)) {
+			delete *chip;
+			*chip = NULL;
+		}
+		return 1;
+	}
+	size_t write(const uint8_t *buffer, size_t size) {
+		for (size_t i = 0; i < size; i++) write(buffer[i]);
+		return size;
+	}
+};
+
+typedef struct {
+	uint16_t	first;
+	uint16_t	last;
+	std::vector<uint8_t>	content;
+} Range;
+
+// Receiver side : the ranges kept, false when the stream is malformed
+static bool parse(const std::vector<uint8_t> &s, std::vector<Range> *ranges, uint8_t *result) {
+	size_t p = 3;
+	ranges->clear();
+	if ((s.size() < 5) || (s[0] != 'F') || (s[1] != 'D')) return false;
+	while ((p < s.size()) && (s[p] == 'R')) {
+		if (p + 5 > s.size()) return false;
+		Range r;
+		r.first = s[p + 1] | (s[p + 2] << 8);
+		r.last = s[p + 3] | (s[p + 4] << 8);
+		p += 5;
+		size_t n = (size_t)r.last - r.first + 1;
+		if ((r.last < r.first) || (p + n > s.size())) return false;
+		r.content.assign(s.begin() + p, s.begin() + p + n);
+		p += n;
+		ranges->push_back(r);
+	}
+	if ((p + 2 != s.size()) || (s[p] != 'E')) return false;
+	*result = s[p + 1];
+	if (*result != ERROR_0) ranges->pop_back();		// completed with zeros
+	return ranges->size() <= s[2];
+}
+
+static bool sameContent(const Range &r, const uint8_t *image) {
+	return memcmp(r.content.data(), &image[r.first], r.content.size()) == 0;
+}
+
+int main(void)
+{
+	FakeFram *chip = new FakeFram(&Wire, MB85RC_DEFAULT_ADDRESS, 512);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	Wire.setClock(400000);
+	memory.begin();
+	CHECK(memory.isReady(), "chip not found");
+
+	static uint8_t image[0x10000];
+	uint8_t data[200];
+	for (int i = 0; i < 200; i++) data[i] = (uint8_t)(i * 13 + 1);
+
+	// complete export
+	memory.clearDirty();
+	memory.writeArray(0x0100, 10, data);
+	memory.writeBlock(0x2000, 200, data);
+	memory.writeArray(0x7000, 1, data);
+	memcpy(image, chip->memory(), sizeof(image));
+	Capture all(&chip, SIZE_MAX);
+	std::vector<Range> ranges;
+	uint8_t result = 0xFF;
+	CHECK(memory.exportDirty(all) == ERROR_0, "exportDirty() failed");
+	CHECK(parse(all.bytes, &ranges, &result), "malformed stream");
+	CHECK((result == ERROR_0) && (ranges.size() == 3), "%u ranges received, result %d", (unsigned int)ranges.size(), result);
+	for (size_t i = 0; i < ranges.size(); i++) CHECK(sameContent(ranges[i], image), "range %u : content differs", (unsigned int)i);
+	CHECK(memory.dirtyCount() == 0, "%u ranges still dirty", memory.dirtyCount());
+
+	// the chip leaves the bus in the middle of the second range
+	memory.writeArray(0x0100, 10, data);
+	memory.writeBlock(0x2000, 200, data);
+	memory.writeArray(0x7000, 1, data);
+	memcpy(image, chip->memory(), sizeof(image));
+	Capture cut(&chip, 3 + 5 + 10 + 5 + 50);
+	byte exported = memory.exportDirty(cut);
+	CHECK(exported != ERROR_0, "exportDirty() succeeded without the chip");
+	CHECK(parse(cut.bytes, &ranges, &result), "malformed stream after a read error");
+	CHECK((result == exported) && (ranges.size() == 1), "%u ranges received, result %d", (unsigned int)ranges.size(), result);
+	if (ranges.size() > 0) CHECK((ranges[0].first == 0x0100) && sameContent(ranges[0], image), "first range differs");
+	uint16_t first;
+	uint32_t items;
+	CHECK((memory.dirtyCount() == 2) && memory.getDirty(0, &first, &items) && (first == 0x2000) && (items == 200),
+		"ranges not received are not dirty anymore");
+	printf("read error : %u bytes streamed, 1 range received, result %d, %u ranges still dirty\n", (unsigned int)cut.bytes.size(), result, memory.dirtyCount());
+
+	// back on the bus : the ranges kept are exported next
+	chip = new FakeFram(&Wire, MB85RC_DEFAULT_ADDRESS, 512);
+	memcpy(chip->memory(), image, sizeof(image));
+	Capture again(&chip, SIZE_MAX);
+	CHECK(memory.exportDirty(again) == ERROR_0, "exportDirty() failed");
+	CHECK(parse(again.bytes, &ranges, &result) && (result == ERROR_0) && (ranges.size() == 2), "%u ranges received", (unsigned int)ranges.size());
+	for (size_t i = 0; i < ranges.size(); i++) CHECK(sameContent(ranges[i], image), "range %u : content differs", (unsigned int)i);
+
+	// a read error on the whole map, once coarsened, keeps it dirty
+	for (uint32_t addr = 0; addr < 0x10000; addr += 0x1000) memory.writeByte((uint16_t)addr, 0x55);
+	CHECK((memory.dirtyCount() == 1) && memory.getDirty(0, &first, &items) && (first == 0) && (items == 0x10000), "whole map not dirty");
+	Capture whole(&chip, 100);
+	CHECK(memory.exportDirty(whole) != ERROR_0, "exportDirty() succeeded without the chip");
+	CHECK(parse(whole.bytes, &ranges, &result) && (result != ERROR_0) && (ranges.size() == 0), "malformed stream, whole map");
+	CHECK((memory.dirtyCount() == 1) && memory.getDirty(0, &first, &items) && (first == 0) && (items == 0x10000), "whole map not dirty anymore");
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
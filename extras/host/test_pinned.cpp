@@ -0,0 +1,84 @@
+/**************************************************************************/
+/*!
+    @file     test_pinned.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of the pinned ranges loaded by begin() : ranges pinned before
+    the chip is found, one of them past the end of the memory map, then a
+    begin() with no chip on the bus.
+    Passes when begin() reports the range failing to load, the other ranges
+    are loaded and served from RAM, and no range is served once a begin()
+    failed to find the chip.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+
+#if FRAM_PIN_MAX < 3
+ #error "build with -DFRAM_PIN_MAX=4"
+#endif
+
+#define MIRROR_SIZE 16
+#define GARBAGE 0xEE
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+// Reads a range, true when its content is the chip's and no bus transfer was needed
+static bool servedFromRam(FRAM_MB85RC_I2C *fram, FakeFram *chip, uint16_t framAddr) {
+	uint8_t data[MIRROR_SIZE];
+	fakeBusClearStats(&Wire);
+	if (fram->readArray(framAddr, MIRROR_SIZE, data) != ERROR_0) return false;
+	return (fakeBusTransfers(&Wire) == 0) && (memcmp(data, &chip->memory()[framAddr], MIRROR_SIZE) == 0);
+}
+
+int main(void)
+{
+	FakeFram *chip = new FakeFram(&Wire, MB85RC_DEFAULT_ADDRESS, 4);	// 512 bytes
+	for (uint32_t i = 0; i < chip->size(); i++) chip->memory()[i] = (uint8_t)(i * 7 + 3);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	Wire.setClock(400000);
+
+	// pinned before the memory map is known, the last range ends past it
+	static uint8_t low[MIRROR_SIZE], middle[MIRROR_SIZE], past[MIRROR_SIZE];
+	memset(low, GARBAGE, MIRROR_SIZE);
+	memset(middle, GARBAGE, MIRROR_SIZE);
+	memset(past, GARBAGE, MIRROR_SIZE);
+	CHECK(memory.pinRegion(0x0010, MIRROR_SIZE, low) == ERROR_0, "pinRegion() failed");
+	CHECK(memory.pinRegion(0x01F8, MIRROR_SIZE, past) == ERROR_0, "pinRegion() failed");
+	CHECK(memory.pinRegion(0x0100, MIRROR_SIZE, middle) == ERROR_0, "pinRegion() failed");
+
+	byte result = memory.begin();
+	printf("begin() with a range past the memory map : result %d\n", result);
+	CHECK(memory.isReady(), "chip not found");
+	CHECK(result == ERROR_11, "begin() returned %d, 11 expected", result);
+	CHECK(servedFromRam(&memory, chip, 0x0010) && servedFromRam(&memory, chip, 0x0100), "ranges loaded not served from RAM");
+	CHECK(memory.unpinRegion(0x01F8) == ERROR_10, "range failing to load still pinned");
+
+	// the range freed, another one fits : pinned & loaded at once
+	static uint8_t last[MIRROR_SIZE];
+	CHECK(memory.pinRegion(0x01F0, MIRROR_SIZE, last) == ERROR_0, "pinRegion() failed");
+	CHECK(servedFromRam(&memory, chip, 0x01F0), "range pinned after begin() not served from RAM");
+	CHECK(memory.pinRegion(0x01F8, MIRROR_SIZE, past) == ERROR_11, "range past the memory map pinned");
+	CHECK(memory.pinRegion(0x0108, MIRROR_SIZE, past) == ERROR_10, "overlapping range pinned");
+
+	// no chip : nothing served from the mirrors
+	delete chip;
+	chip = NULL;
+	result = memory.begin();
+	CHECK(result == ERROR_7, "begin() without the chip returned %d, 7 expected", result);
+	uint8_t data[MIRROR_SIZE];
+	CHECK(memory.readArray(0x0010, MIRROR_SIZE, data) != ERROR_0, "range served from RAM without the chip");
+	CHECK(memory.unpinRegion(0x0010) == ERROR_10, "range still pinned without the chip");
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+/**************************************************************************/
+/*!
+    @file     test_recordstore.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of the FramRecordStore compaction chunks : large live records
+    separated by small dead ones, then a dead run longer than a burst.
+    Passes when poll() leaves the small dead runs alone, moves burst sized
+    chunks once the long run exists, compact() sweeps the rest, and every
+    record reads back after a reload.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+#include "FramRecordStore.h"
+
+#define REGION 0x0100
+#define REGION_SIZE 4096
+#define PAIRS 12
+#define LARGE 100		// payload of the live records
+#define SMALL 4			// payload of the records removed
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static void fillPayload(uint8_t data[], uint16_t record) {
+	for (uint16_t i = 0; i < LARGE; i++) data[i] = (uint8_t)(record * 31 + i);
+}
+
+static uint16_t checkRecords(FramRecordStore *store, uint16_t ids[], boolean live[]) {
+	uint16_t bad = 0;
+	uint8_t expected[LARGE];
+	uint8_t data[LARGE];
+	for (uint16_t i = 0; i < PAIRS; i++) {
+		if (!live[i]) continue;
+		uint16_t length = 0;
+		fillPayload(expected, i);
+		if ((store->read(ids[i], data, sizeof(data), &length) != ERROR_0) || (length != LARGE) || (memcmp(data, expected, LARGE) != 0)) bad++;
+	}
+	return bad;
+}
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, 256);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	Wire.setClock(400000);
+	memory.begin();
+	CHECK(memory.isReady(), "chip not found");
+
+	FramRecordStore store(&memory, REGION, REGION_SIZE);
+	CHECK(store.format() == ERROR_0, "format() failed");
+
+	// large live records, each followed by a small one
+	uint16_t ids[PAIRS];
+	uint16_t smallIds[PAIRS];
+	boolean live[PAIRS];
+	uint8_t data[LARGE];
+	for (uint16_t i = 0; i < PAIRS; i++) {
+		fillPayload(data, i);
+		CHECK(store.append(data, LARGE, &ids[i]) == ERROR_0, "append() failed");
+		CHECK(store.append(data, SMALL, &smallIds[i]) == ERROR_0, "append() failed");
+		live[i] = true;
+	}
+
+	// small dead runs only : plenty of dead bytes, but no burst sized chunk to move.
+	// The last one ends the log, cutting it is a single byte write.
+	for (uint16_t i = 0; i < PAIRS; i++) CHECK(store.remove(smallIds[i]) == ERROR_0, "remove() failed");
+	CHECK(store.deadBytes() >= FRAM_RS_COMPACT_MIN, "%u dead bytes", store.deadBytes());
+	fakeBusClearStats(&Wire);
+	for (int i = 0; i < 10; i++) store.poll();
+	printf("small dead runs : %u dead bytes, %u transfers from poll()\n", store.deadBytes(), fakeBusTransfers(&Wire));
+	CHECK(!store.compacting() && (fakeBusTransfers(&Wire) == 1), "poll() compacted small dead runs");
+	CHECK(store.deadBytes() == (PAIRS - 1) * (FRAM_RS_RECORD_HEADER + SMALL), "log end not cut");
+
+	// a long dead run in the middle : poll() compacts from there, burst sized chunks only
+	CHECK(store.remove(ids[PAIRS / 2]) == ERROR_0, "remove() failed");
+	live[PAIRS / 2] = false;
+	uint16_t dead = store.deadBytes();
+	uint32_t calls = 0, chunks = 0, shorter = 0;
+	do {
+		CHECK(store.poll() == ERROR_0, "poll() failed");
+		calls++;
+		if (chip.memory()[REGION + 11] == FRAM_RS_MOVING) {
+			chunks++;
+			if (chip.memory()[REGION + 10] != FRAM_BURST_SIZE) shorter++;
+		}
+	} while (store.compacting() && (calls < 10000));
+	printf("long dead run : %u poll() calls, %u chunk sizes seen, %u shorter than a burst, %u dead bytes left out of %u\n",
+		calls, chunks, shorter, store.deadBytes(), dead);
+	CHECK(chunks > 0, "poll() did not compact");
+	CHECK(shorter == 0, "%u chunks shorter than a burst", shorter);
+	CHECK(store.deadBytes() < dead, "nothing reclaimed");
+	CHECK(checkRecords(&store, ids, live) == 0, "records differ after poll()");
+
+	// compact() sweeps whatever is left
+	CHECK(store.compact() == ERROR_0, "compact() failed");
+	CHECK(store.deadBytes() == 0, "%u dead bytes left by compact()", store.deadBytes());
+
+	FramRecordStore reloaded(&memory, REGION, REGION_SIZE);
+	CHECK(reloaded.begin() == ERROR_0, "begin() failed");
+	CHECK(checkRecords(&reloaded, ids, live) == 0, "records differ after reload");
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/**************************************************************************/
+/*!
+    @file     test_scrubber.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of FramScrubber time budgets. Time is simulated (FakeFram.h) :
+    the time a poll() takes is its bus time, exactly. Delays are injected
+    from a plugged bus lock, in the wait for the lock or inside a transfer
+    (the lock is recursive, the nested take happens during the step).
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+#include "FramScrubber.h"
+
+#if !FRAM_THREAD_SAFE
+ #error "build with -DFRAM_THREAD_SAFE=1"
+#endif
+
+#define REGION 0x0100
+#define REGION_SIZE 1024
+#define BLOCK_SIZE 64
+#define CRC_TABLE 0x1000
+#define BUDGET_US 200
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+// Delay injected at the n-th lock taken from now : 1 = wait for the lock, 2 = inside the transfer
+static int lockDepth = 0;
+static int delayAt = 0;
+static unsigned int delayUs = 0;
+
+static void lockBus(TwoWire *wire) {
+	(void)wire;
+	lockDepth++;
+	if (lockDepth == delayAt) {
+		delayMicroseconds(delayUs);
+		delayAt = 0;
+	}
+}
+static void unlockBus(TwoWire *wire) { (void)wire; lockDepth--; }
+
+static uint32_t reported = 0;
+static void onError(uint16_t framAddr, uint16_t items) { (void)framAddr; (void)items; reported++; }
+
+// Polls until a pass completes, checking every call against the budget
+static uint32_t scrubPass(FramScrubber *scrubber, uint32_t budgetUs, uint32_t *overruns, uint32_t *maxUs) {
+	uint32_t passes = scrubber->passes();
+	uint32_t calls = 0;
+	while ((scrubber->passes() == passes) && (calls < 100000)) {
+		unsigned long t0 = micros();
+		byte result = scrubber->poll(budgetUs);
+		unsigned long elapsed = micros() - t0;
+		CHECK((result == ERROR_0) || (result == ERROR_13), "poll() returned %d", result);
+		if (elapsed > budgetUs) (*overruns)++;
+		if (elapsed > *maxUs) *maxUs = elapsed;
+		calls++;
+	}
+	return calls;
+}
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, 256);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	FRAM_MB85RC_I2C::setBusLock(lockBus, unlockBus);
+	Wire.setClock(400000);
+	memory.begin();
+	CHECK(memory.isReady(), "chip not found");
+
+	for (uint16_t i = 0; i < REGION_SIZE; i++) chip.memory()[REGION + i] = (uint8_t)(i * 7);
+
+	FramScrubber scrubber(&memory, onError);
+	CHECK(scrubber.addRegion(REGION, REGION_SIZE, BLOCK_SIZE, CRC_TABLE) == ERROR_0, "addRegion() failed");
+	CHECK(scrubber.seal(0) == ERROR_0, "seal() failed");
+
+	// 400 kHz : a pass within budget from the first call, the probe of addRegion() being the first measure
+	uint32_t overruns = 0, maxUs = 0;
+	uint32_t calls = scrubPass(&scrubber, BUDGET_US, &overruns, &maxUs);
+	printf("400 kHz, poll(%d) : pass in %u calls, longest %u us\n", BUDGET_US, calls, maxUs);
+	CHECK(overruns == 0, "%u calls over budget", overruns);
+	CHECK(scrubber.errors() == 0, "%u false errors", scrubber.errors());
+
+	// a corrupted byte is reported
+	chip.memory()[REGION + 3 * BLOCK_SIZE + 5] ^= 0x10;
+	scrubPass(&scrubber, BUDGET_US, &overruns, &maxUs);
+	CHECK((reported == 1) && (scrubber.errors() == 1), "corruption reported %u times", reported);
+	chip.memory()[REGION + 3 * BLOCK_SIZE + 5] ^= 0x10;
+
+	// a long wait for the lock is not taken for bus time : the next steps are sized as before
+	delayUs = 5000;
+	lockDepth = 0;
+	delayAt = 1;
+	scrubber.poll(BUDGET_US);
+	overruns = 0;
+	maxUs = 0;
+	uint32_t after = scrubPass(&scrubber, BUDGET_US, &overruns, &maxUs);
+	printf("after a 5 ms lock wait : pass in %u calls\n", after);
+	CHECK(after <= calls + 1, "pass took %u calls instead of %u", after, calls);
+	CHECK(overruns == 0, "%u calls over budget", overruns);
+
+	// a preemption inside a transfer inflates the estimate for a while only
+	for (int i = 0; i < 3; i++) {
+		delayAt = 2;
+		scrubber.poll(BUDGET_US);
+	}
+	overruns = 0;
+	maxUs = 0;
+	scrubPass(&scrubber, BUDGET_US, &overruns, &maxUs);
+	after = scrubPass(&scrubber, BUDGET_US, &overruns, &maxUs);
+	printf("after 3 preemptions of 5 ms : pass in %u calls\n", after);
+	CHECK(after <= calls + 1, "no recovery, pass took %u calls instead of %u", after, calls);
+
+	// 100 kHz : the slower bus is learnt from the first step (that one overruns, the clock
+	// change is not announced), then not even a 1 byte read fits 200 us and nothing is done
+	Wire.setClock(100000);
+	uint32_t learning = 0;
+	for (int i = 0; i < 100; i++) {
+		unsigned long t0 = micros();
+		scrubber.poll(BUDGET_US);
+		if (micros() - t0 > BUDGET_US) learning++;
+	}
+	uint32_t nothing = 0;
+	for (int i = 0; i < 100; i++) {
+		unsigned long t0 = micros();
+		if ((scrubber.poll(BUDGET_US) == ERROR_13) && (micros() == t0)) nothing++;
+	}
+	printf("100 kHz, poll(%d) : %u steps over budget while learning, then %u calls out of 100 return ERROR_13\n", BUDGET_US, learning, nothing);
+	CHECK(learning <= 1, "%u steps over budget", learning);
+	CHECK(nothing == 100, "%u calls out of 100 returned ERROR_13 without bus access", nothing);
+
+	// a larger budget resumes the scrub
+	overruns = 0;
+	maxUs = 0;
+	calls = scrubPass(&scrubber, 1000, &overruns, &maxUs);
+	printf("100 kHz, poll(1000) : pass in %u calls, longest %u us\n", calls, maxUs);
+	CHECK(calls < 100000, "no progress");
+	CHECK(overruns == 0, "%u calls over budget", overruns);
+
+	// no estimate yet (no chip answering the probe of addRegion()) : the probe waits for a budget covering it
+	FRAM_MB85RC_I2C absent(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	absent.setWire(&Wire1);
+	FramScrubber unmeasured(&absent, onError);
+	CHECK(unmeasured.addRegion(0, REGION_SIZE, BLOCK_SIZE, CRC_TABLE) == ERROR_0, "addRegion() failed");
+	fakeBusClearStats(&Wire1);
+	CHECK(unmeasured.poll(BUDGET_US) == ERROR_13, "probe started within %d us", BUDGET_US);
+	CHECK(fakeBusTransfers(&Wire1) == 0, "bus accessed by poll(%d) without an estimate", BUDGET_US);
+	byte probed = unmeasured.poll(1000);
+	CHECK((probed != ERROR_0) && (probed != ERROR_13) && (fakeBusTransfers(&Wire1) > 0), "probe not run by poll(1000), result %d", probed);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+/**************************************************************************/
+/*!
+    @file     test_slab.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of FramSlabAllocator : random alloc / free rounds against a
+    reference map of the slots handed out, with class sizes that are not
+    multiples of 8 so the search wraps in the middle of a bitmap byte.
+    Passes when no slot is handed out twice, a freed slot is the next one
+    allocated, and the bitmap reloads as left.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <set>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+#include "FramSlabAllocator.h"
+
+#define REGION 0x0100
+#define ROUNDS 5000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, 256);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	Wire.setClock(400000);
+	memory.begin();
+	CHECK(memory.isReady(), "chip not found");
+
+	const FramSlabClass classes[3] = { { 8, 21 }, { 32, 43 }, { 64, 13 } };
+	FramSlabAllocator slab(&memory, REGION, classes, 3);
+	CHECK(slab.format() == ERROR_0, "format() failed");
+
+	std::set<uint16_t> used;
+	unsigned int seed = 3;
+	uint32_t twice = 0, refused = 0, notReused = 0;
+	for (int round = 0; round < ROUNDS; round++) {
+		uint16_t size = classes[rand_r(&seed) % 3].slotSize;
+		if ((rand_r(&seed) % 3) || used.empty()) {
+			uint16_t addr;
+			byte result = slab.alloc(size, &addr);
+			if (result == ERROR_11) continue;
+			if (result != ERROR_0) refused++;
+			else if (!used.insert(addr).second) twice++;
+		}
+		else {
+			std::set<uint16_t>::iterator it = used.begin();
+			std::advance(it, rand_r(&seed) % used.size());
+			uint16_t addr = *it;
+			used.erase(it);
+			if (slab.free(addr) != ERROR_0) refused++;
+
+			// the slot just freed comes first in its class
+			uint16_t again;
+			uint16_t slotSize = (addr >= REGION + 2 + 10 + 21 * 8 + 43 * 32) ? 64 : (addr >= REGION + 2 + 10 + 21 * 8) ? 32 : 8;
+			if ((slab.alloc(slotSize, &again) != ERROR_0) || (again != addr)) notReused++;
+			else used.insert(again);
+		}
+	}
+	printf("%d rounds : %u slots allocated at the end\n", ROUNDS, (unsigned int)used.size());
+	CHECK(twice == 0, "%u slots handed out twice", twice);
+	CHECK(refused == 0, "%u failed calls", refused);
+	CHECK(notReused == 0, "%u freed slots not allocated next", notReused);
+
+	FramSlabAllocator reloaded(&memory, REGION, classes, 3);
+	CHECK(reloaded.begin() == ERROR_0, "begin() failed");
+	uint32_t wrong = 0;
+	for (std::set<uint16_t>::iterator it = used.begin(); it != used.end(); ++it) if (!reloaded.isAllocated(*it)) wrong++;
+	uint16_t freeTotal = reloaded.freeSlots(0) + reloaded.freeSlots(1) + reloaded.freeSlots(2);
+	CHECK((wrong == 0) && (freeTotal + used.size() == 21 + 43 + 13), "bitmap reloaded differs");
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+/**************************************************************************/
+/*!
+    @file     test_threads.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of the shared bus locking (FRAM_THREAD_SAFE) : std::thread
+    tasks hammer one simulated bus, directly and through FramBusQueue. The
+    bus lock is plugged with setBusLock(), one mutex per bus, as on an RTOS
+    other than ESP32.
+
+    Passes when every task reads back what it wrote, the bus saw no
+    collision, and a task holding the lock of one bus does not stop a
+    transfer on the other. The same workload without lock is run last for
+    reference.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+#include "FramBusQueue.h"
+
+#if !FRAM_THREAD_SAFE
+ #error "build with -DFRAM_THREAD_SAFE=1"
+#endif
+
+#define TASKS 4
+#define ROUNDS 2000
+#define TASK_REGION 0x0400		// bytes of FRAM per task
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static std::recursive_mutex busMutex[2];
+static void lockBus(TwoWire *wire) { busMutex[wire == &Wire1].lock(); }
+static void unlockBus(TwoWire *wire) { busMutex[wire == &Wire1].unlock(); }
+
+static FRAM_MB85RC_I2C *fram;
+static FramBusQueue *queue;
+
+// Each task writes & reads back bursts in its own region, with bit operations in between
+static void directTask(int task, uint32_t *errors) {
+	uint16_t base = task * TASK_REGION;
+	uint8_t out[FRAM_BURST_SIZE];
+	uint8_t in[FRAM_BURST_SIZE];
+	unsigned int seed = task + 1;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		byte items = 1 + rand_r(&seed) % FRAM_BURST_SIZE;
+		uint16_t offset = rand_r(&seed) % (TASK_REGION - FRAM_BURST_SIZE);
+		for (byte i = 0; i < items; i++) out[i] = (uint8_t)(task << 6 | (round + i));
+
+		if (fram->writeArray(base + offset, items, out) != ERROR_0) (*errors)++;
+		if (fram->readArray(base + offset, items, in) != ERROR_0) (*errors)++;
+		if (memcmp(in, out, items) != 0) (*errors)++;
+
+		uint8_t bit;
+		if (fram->setOneBit(base + offset, 7) != ERROR_0) (*errors)++;
+		if ((fram->readBit(base + offset, 7, &bit) != ERROR_0) || (bit != 1)) (*errors)++;
+	}
+}
+
+// Small neighbouring requests from every task, for the queue to merge
+static void queueTask(int task, uint32_t *errors) {
+	uint8_t out[4];
+	uint8_t in[4];
+
+	for (int round = 0; round < ROUNDS; round++) {
+		uint16_t framAddr = 0x2000 + ((round % 64) * TASKS + task) * 4;
+		for (byte i = 0; i < 4; i++) out[i] = (uint8_t)(task + round + i);
+
+		if (queue->writeArray(framAddr, 4, out) != ERROR_0) (*errors)++;
+		if (queue->readArray(framAddr, 4, in) != ERROR_0) (*errors)++;
+		if (memcmp(in, out, 4) != 0) (*errors)++;
+	}
+}
+
+// Holds the lock of one bus until a task has written to the chip on the other bus, 1 s at most
+static std::atomic<bool> otherBusDone(false);
+static bool doneWhileHeld = false;
+
+static void holdTask(FRAM_MB85RC_I2C *held) {
+	held->busLock();
+	std::chrono::steady_clock::time_point limit = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (!otherBusDone && (std::chrono::steady_clock::now() < limit)) std::this_thread::yield();
+	doneWhileHeld = otherBusDone;
+	held->busUnlock();
+}
+
+static void otherBusTask(FRAM_MB85RC_I2C *other, byte *result) {
+	uint8_t out[FRAM_BURST_SIZE];
+	memset(out, 0x5A, sizeof(out));
+	*result = other->writeArray(0x0000, FRAM_BURST_SIZE, out);
+	otherBusDone = true;
+}
+
+static uint32_t runTasks(void (*task)(int, uint32_t *)) {
+	std::vector<std::thread> threads;
+	uint32_t errors[TASKS] = { 0 };
+	for (int t = 0; t < TASKS; t++) threads.push_back(std::thread(task, t, &errors[t]));
+	uint32_t total = 0;
+	for (int t = 0; t < TASKS; t++) {
+		threads[t].join();
+		total += errors[t];
+	}
+	return total;
+}
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, 256);
+	FakeFram chip1(&Wire1, MB85RC_DEFAULT_ADDRESS, 256);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	FRAM_MB85RC_I2C memory1(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	memory1.setWire(&Wire1);
+	FramBusQueue busQueue(&memory);
+	fram = &memory;
+	queue = &busQueue;
+
+	FRAM_MB85RC_I2C::setBusLock(lockBus, unlockBus);
+	memory.begin();
+	memory1.begin();
+	CHECK(memory.isReady() && memory1.isReady(), "chip not found");
+
+	fakeBusClearStats(&Wire);
+	uint32_t errors = runTasks(directTask);
+	CHECK(errors == 0, "direct access : %u errors", errors);
+	CHECK(fakeBusCollisions(&Wire) == 0, "direct access : %u bus collisions", fakeBusCollisions(&Wire));
+
+	fakeBusClearStats(&Wire);
+	errors = runTasks(queueTask);
+	CHECK(errors == 0, "queued access : %u errors", errors);
+	CHECK(fakeBusCollisions(&Wire) == 0, "queued access : %u bus collisions", fakeBusCollisions(&Wire));
+	CHECK(busQueue.transferCount() <= busQueue.requestCount(), "queue issued more transfers than requests");
+	printf("queue : %u requests, %u transfers\n", busQueue.requestCount(), busQueue.transferCount());
+
+	// one lock per bus : a transfer on Wire1 goes on while the lock of Wire is held
+	byte otherResult = ERROR_2;
+	std::thread hold(holdTask, &memory);
+	while (busMutex[0].try_lock()) {
+		busMutex[0].unlock();
+		std::this_thread::yield();
+	}
+	std::thread other(otherBusTask, &memory1, &otherResult);
+	other.join();
+	hold.join();
+	CHECK(doneWhileHeld, "transfer on Wire1 waited for the lock of Wire");
+	CHECK((otherResult == ERROR_0) && (chip1.memory()[FRAM_BURST_SIZE - 1] == 0x5A), "transfer on Wire1 failed : %d", otherResult);
+
+	// reference : what the lock prevents, not checked - depends on the scheduling
+	FRAM_MB85RC_I2C::setBusLock(NULL, NULL);
+	fakeBusClearStats(&Wire);
+	errors = runTasks(directTask);
+	printf("without lock : %u errors, %u bus collisions\n", errors, fakeBusCollisions(&Wire));
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+/**************************************************************************/
+/*!
+    @file     test_timeseries.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Host test of FramTimeSeries queries with repeated timestamps : runs of
+    samples sharing a timestamp, spanning block boundaries in small blocks.
+    Passes when a query of each timestamp returns its whole run, and paging
+    by a few samples at a time returns every sample exactly once.
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+#include "FramTimeSeries.h"
+
+#define REGION 0x0100
+#define BLOCK_SIZE 32
+#define BLOCKS 40
+#define SAMPLES 250
+#define RUN 7			// samples per timestamp
+#define PAGE 3
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+int main(void)
+{
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, 256);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS);
+	Wire.setClock(400000);
+	memory.begin();
+	CHECK(memory.isReady(), "chip not found");
+
+	FramTimeSeries series(&memory, REGION, BLOCKS * BLOCK_SIZE, BLOCK_SIZE);
+	CHECK(series.format() == ERROR_0, "format() failed");
+	for (int i = 0; i < SAMPLES; i++) CHECK(series.append(1000 + i / RUN, i) == ERROR_0, "append() failed");
+	CHECK(series.usedBlocks() < BLOCKS, "ring wrapped, test too large");
+
+	// each timestamp alone : its whole run, whichever blocks hold it
+	uint32_t timestamps[RUN + 1];
+	int32_t values[RUN + 1];
+	uint16_t found;
+	uint32_t shortRuns = 0;
+	for (int i = 0; i < SAMPLES; i += RUN) {
+		uint32_t t = 1000 + i / RUN;
+		CHECK(series.query(t, t, timestamps, values, RUN + 1, &found) == ERROR_0, "query() failed");
+		int expected = ((SAMPLES - i) < RUN) ? (SAMPLES - i) : RUN;
+		if ((found != expected) || (values[0] != i)) shortRuns++;
+	}
+	printf("%d samples, %d per timestamp, in %u blocks : %u timestamps with samples missing\n", SAMPLES, RUN, series.usedBlocks(), shortRuns);
+	CHECK(shortRuns == 0, "%u timestamps with samples missing", shortRuns);
+
+	// paging : from the last timestamp returned, skipping its samples already returned
+	uint32_t t1 = 0;
+	uint16_t skip = 0;
+	int next = 0;
+	uint32_t wrong = 0;
+	do {
+		CHECK(series.query(t1, 0xFFFFFFFF, timestamps, values, PAGE, &found, skip) == ERROR_0, "query() failed");
+		for (uint16_t k = 0; k < found; k++) if (values[k] != next++) wrong++;
+		if (found == 0) break;
+		uint32_t last = timestamps[found - 1];
+		uint16_t same = 0;
+		while ((same < found) && (timestamps[found - 1 - same] == last)) same++;
+		skip = (last == t1) ? skip + same : same;
+		t1 = last;
+	} while (found == PAGE);
+	CHECK((wrong == 0) && (next == SAMPLES), "paging : %d samples, %u out of order", next, wrong);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+/**************************************************************************/
+/*!
+    @file     trace_replay.cpp
+    @author   SOSAndroid (E. Ha.)
+    @license  BSD (see license.txt)
+
+    Replays an access trace captured by FRAM_MB85RC_I2C::exportTrace()
+    through the lib itself, on a simulated chip (FakeFram.h), to choose the
+    ranges to pin before pinning them on the target.
+
+    Reads are replayed as the application did them : a read record followed
+    by latch records continuing it is one readBlock(), other reads are
+    readArray(), including those the capture served from a pinned range.
+    A capture taken with ranges pinned records the bursts of readBlock() as
+    separate reads, they are replayed as such. Writes are writeArray(). Bus
+    time is the simulated time of the replay, begin() and the loading of the
+    pinned ranges excluded.
+
+    Reports, for the capture without pinned ranges then for each --pins
+    setting : bus transfers, bytes, bus time, share of the capture span the
+    bus is busy (above 100% the workload does not fit that clock) and reads
+    served from RAM. extras/trace_replay.py draws the heatmap of a capture.
+
+    Usage :
+      make replay TRACE=capture.csv REPLAY_ARGS="--clock 400000 --pins 0x0000-0x00ff --pins 0x0000-0x00ff,0x1000-0x10ff"
+      build/trace_replay [--clock HZ] [--density KBIT] [--pins FIRST-LAST[,FIRST-LAST...]]... capture.csv|-
+
+    Up to FRAM_PIN_MAX ranges a setting (4, Makefile TEST_FLAGS).
+
+    @section  HISTORY
+
+    v1.0 - First release
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "FakeFram.h"
+#include "FRAM_MB85RC_I2C.h"
+
+#if FRAM_PIN_MAX < 1
+ #error "build with -DFRAM_PIN_MAX=4"
+#endif
+
+typedef struct {
+	char		op;
+	uint16_t	framAddr;
+	uint8_t		items;
+	uint32_t	time;
+} Record;
+
+typedef struct {
+	uint16_t	first;
+	uint16_t	last;
+} PinRange;
+
+typedef struct {
+	std::string		name;
+	std::vector<PinRange>	pins;
+} Setting;
+
+typedef struct {
+	uint32_t	transfers;
+	uint32_t	bytes;
+	uint32_t	busUs;
+	uint32_t	reads;
+	uint32_t	hits;
+} Result;
+
+static void usage(void) {
+	fprintf(stderr, "usage : trace_replay [--clock HZ] [--density KBIT] [--pins FIRST-LAST[,FIRST-LAST...]]... capture.csv|-\n");
+	exit(2);
+}
+
+// Trace lines of exportTrace(), other lines are ignored. Returns false when the file cannot be read.
+static bool parseTrace(FILE *in, std::vector<Record> *records, uint16_t *density, uint32_t *lost) {
+	char line[256];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		unsigned int d;
+		unsigned long l;
+		if (sscanf(line, "# FRAM trace,%u,%lu", &d, &l) == 2) {
+			*density = (uint16_t)d;
+			*lost = (uint32_t)l;
+			continue;
+		}
+		char op;
+		unsigned int addr, items;
+		unsigned long time;
+		if (sscanf(line, "%c,%u,%u,%lu", &op, &addr, &items, &time) != 4) continue;
+		if ((op != FRAM_TRACE_READ) && (op != FRAM_TRACE_LATCH) && (op != FRAM_TRACE_PINNED) && (op != FRAM_TRACE_WRITE)) continue;
+		if ((addr > 0xFFFF) || (items == 0) || (items > 0xFF)) continue;
+		Record r = { op, (uint16_t)addr, (uint8_t)items, (uint32_t)time };
+		records->push_back(r);
+	}
+	return !ferror(in);
+}
+
+static bool parsePins(const char *text, Setting *setting) {
+	std::string list(text);
+	size_t pos = 0;
+	while (pos <= list.size()) {
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos) end = list.size();
+		std::string range = list.substr(pos, end - pos);
+		char *dash;
+		unsigned long first = strtoul(range.c_str(), &dash, 0);
+		if (*dash != '-') return false;
+		char *stop;
+		unsigned long last = strtoul(dash + 1, &stop, 0);
+		if ((*stop != '\0') || (last < first) || (last > 0xFFFF)) return false;
+		PinRange p = { (uint16_t)first, (uint16_t)last };
+		setting->pins.push_back(p);
+		pos = end + 1;
+	}
+	setting->name = std::string("pins ") + text;
+	return setting->pins.size() <= FRAM_PIN_MAX;
+}
+
+// Replays the capture on a new chip with the setting's ranges pinned
+static byte replay(const std::vector<Record> &records, uint16_t density, uint32_t clock, const Setting &setting, Result *result) {
+	static uint8_t buffer[0x10000];
+	FakeFram chip(&Wire, MB85RC_DEFAULT_ADDRESS, density, false);
+	FRAM_MB85RC_I2C memory(MB85RC_DEFAULT_ADDRESS, DEFAULT_WP_STATUS, DEFAULT_WP_PIN, density);
+	Wire.setClock(clock);
+	byte status = memory.begin();
+	if (status != ERROR_0) return status;
+
+	std::vector<std::vector<uint8_t> > mirrors(setting.pins.size());
+	for (size_t i = 0; i < setting.pins.size(); i++) {
+		uint16_t items = setting.pins[i].last - setting.pins[i].first + 1;
+		mirrors[i].resize(items);
+		status = memory.pinRegion(setting.pins[i].first, items, mirrors[i].data());
+		if (status != ERROR_0) return status;
+	}
+
+	memset(result, 0, sizeof(Result));
+	fakeBusClearStats(&Wire);
+	unsigned long start = micros();
+	size_t i = 0;
+	while (i < records.size()) {
+		const Record &r = records[i];
+		uint32_t transfers = fakeBusTransfers(&Wire);
+		if (r.op == FRAM_TRACE_WRITE) {
+			memory.writeArray(r.framAddr, r.items, buffer);
+			i++;
+			continue;
+		}
+		if (r.op == FRAM_TRACE_READ) {
+			// a read and the latch reads continuing it : one readBlock()
+			uint32_t items = r.items;
+			size_t next = i + 1;
+			while ((next < records.size()) && (records[next].op == FRAM_TRACE_LATCH)
+				&& (records[next].framAddr == r.framAddr + items) && (items + records[next].items <= 0xFFFF)) {
+				items += records[next++].items;
+			}
+			memory.readBlock(r.framAddr, (uint16_t)items, buffer);
+			i = next;
+		}
+		else {
+			memory.readArray(r.framAddr, r.items, buffer);	// pinned in the capture, or a latch read on its own
+			i++;
+		}
+		result->reads++;
+		if (fakeBusTransfers(&Wire) == transfers) result->hits++;
+	}
+	result->busUs = micros() - start;
+	result->transfers = fakeBusTransfers(&Wire);
+	result->bytes = fakeBusBytes(&Wire);
+	return ERROR_0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t clock = 100000;
+	uint16_t density = 0;
+	const char *path = NULL;
+	std::vector<Setting> settings(1);
+	settings[0].name = "no pins";
+
+	for (int a = 1; a < argc; a++) {
+		if ((strcmp(argv[a], "--clock") == 0) && (a + 1 < argc)) {
+			clock = (uint32_t)strtoul(argv[++a], NULL, 0);
+		}
+		else if ((strcmp(argv[a], "--density") == 0) && (a + 1 < argc)) {
+			density = (uint16_t)strtoul(argv[++a], NULL, 0);
+		}
+		else if ((strcmp(argv[a], "--pins") == 0) && (a + 1 < argc)) {
+			Setting setting;
+			if (!parsePins(argv[++a], &setting)) {
+				fprintf(stderr, "pinned ranges are FIRST-LAST[,FIRST-LAST...], up to %d of them : %s\n", FRAM_PIN_MAX, argv[a]);
+				return 2;
+			}
+			settings.push_back(setting);
+		}
+		else if ((argv[a][0] != '-') || (strcmp(argv[a], "-") == 0)) {
+			path = argv[a];
+		}
+		else {
+			usage();
+		}
+	}
+	if ((path == NULL) || (clock == 0)) usage();
+
+	FILE *in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+	if (in == NULL) {
+		perror(path);
+		return 2;
+	}
+	std::vector<Record> records;
+	uint16_t captured = 0;
+	uint32_t lost = 0;
+	bool readOk = parseTrace(in, &records, &captured, &lost);
+	if (in != stdin) fclose(in);
+	if (!readOk || records.empty()) {
+		fprintf(stderr, "no trace records found in %s\n", path);
+		return 2;
+	}
+	if (density == 0) density = captured;
+	if (density == 0) {
+		fprintf(stderr, "no density in the trace header, give --density\n");
+		return 2;
+	}
+
+	uint32_t counts[4] = { 0, 0, 0, 0 };
+	const char ops[4] = { FRAM_TRACE_READ, FRAM_TRACE_LATCH, FRAM_TRACE_PINNED, FRAM_TRACE_WRITE };
+	uint32_t span = 0;
+	for (size_t i = 0; i < records.size(); i++) {
+		for (int k = 0; k < 4; k++) if (records[i].op == ops[k]) counts[k]++;
+		if (i > 0) span += records[i].time - records[i - 1].time;	// micros() wraps every 71 minutes
+	}
+	printf("%u records (R:%u L:%u P:%u W:%u), %u lost before the oldest one\n", (unsigned int)records.size(),
+		counts[0], counts[1], counts[2], counts[3], lost);
+	printf("density %u Kbit, clock %u Hz, capture span %u us\n", density, clock, span);
+
+	printf("\n  %-32s %10s %9s %9s %6s %10s\n", "setting", "transfers", "bytes", "bus us", "busy", "read hits");
+	int failed = 0;
+	for (size_t s = 0; s < settings.size(); s++) {
+		Result result;
+		byte status = replay(records, density, clock, settings[s], &result);
+		if (status != ERROR_0) {
+			printf("  %-32s replay failed, error %d\n", settings[s].name.c_str(), status);
+			failed++;
+			continue;
+		}
+		char busy[16] = "-";
+		if (span > 0) snprintf(busy, sizeof(busy), "%u%%", (unsigned int)(100.0 * result.busUs / span));
+		printf("  %-32s %10u %9u %9u %6s %9.1f%%\n", settings[s].name.c_str(), result.transfers, result.bytes, result.busUs, busy,
+			result.reads ? 100.0 * result.hits / result.reads : 0.0);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""
+    trace_replay.py
+    Author : SOSAndroid (E. Ha.)
+    License : BSD (see license.txt)
+
+    Summary & per region heatmap of an access trace captured by
+    FRAM_MB85RC_I2C::exportTrace() : the records of each kind, the capture
+    span, and the bytes read & written in each region of the memory map.
+
+    Bus time & read hits of pinning settings are measured by replaying the
+    capture through the lib itself : extras/host, make replay (see
+    extras/host/trace_replay.cpp).
+
+    Usage :
+      python3 trace_replay.py capture.csv
+      python3 trace_replay.py capture.csv --region 1024 --width 60
+
+    Capture : build with FRAM_TRACE_DEPTH set (e.g. 256), call traceStart(),
+    run the workload, then exportTrace(Serial) and save the Serial output.
+    Lines not belonging to the trace are ignored.
+"""
+
+import argparse
+import collections
+import sys
+
+OPS = ("R", "L", "P", "W")
+
+
+class Trace(object):
+    def __init__(self):
+        self.density = None
+        self.lost = 0
+        self.records = []   # (op, addr, length, us)
+
+
+def parse_trace(lines):
+    trace = Trace()
+    for line in lines:
+        line = line.strip()
+        if line.startswith("# FRAM trace,"):
+            fields = line.split(",")
+            try:
+                trace.density = int(fields[1])
+                trace.lost = int(fields[2])
+            except (IndexError, ValueError):
+                pass
+            continue
+        fields = line.split(",")
+        if len(fields) != 4 or fields[0] not in OPS:
+            continue
+        try:
+            trace.records.append((fields[0], int(fields[1]), int(fields[2]), int(fields[3])))
+        except ValueError:
+            continue
+    return trace
+
+
+def capture_span(trace):
+    if len(trace.records) < 2:
+        return 0
+    span = 0
+    for previous, current in zip(trace.records, trace.records[1:]):
+        span += (current[3] - previous[3]) & 0xFFFFFFFF   # micros() wraps every 71 minutes
+    return span
+
+
+def heatmap(trace, region, width):
+    reads = collections.Counter()
+    writes = collections.Counter()
+    for op, addr, length, _ in trace.records:
+        counter = writes if op == "W" else reads
+        pos, end = addr, addr + length
+        while pos < end:
+            n = min(end, (pos // region + 1) * region) - pos
+            counter[pos // region] += n
+            pos += n
+    regions = sorted(set(reads) | set(writes))
+    peak = max([reads[r] + writes[r] for r in regions] or [1])
+    print("\nHeatmap, %d bytes per region (r: read - w: written)" % region)
+    print("  region          read   written")
+    for r in regions:
+        total = reads[r] + writes[r]
+        bar = int(round(total * width / float(peak)))
+        rbar = int(round(bar * reads[r] / float(total))) if total else 0
+        print("  0x%04x-0x%04x %7d %9d  %s%s" % (r * region, (r + 1) * region - 1, reads[r], writes[r],
+                                              "r" * rbar, "w" * (bar - rbar)))
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Summary & heatmap of a FRAM_MB85RC_I2C access trace")
+    parser.add_argument("trace", help="exportTrace() output, '-' for stdin")
+    parser.add_argument("--region", type=int, default=256, help="heatmap region size in bytes (default 256)")
+    parser.add_argument("--width", type=int, default=40, help="heatmap bar width (default 40)")
+    args = parser.parse_args(argv)
+
+    source = sys.stdin if args.trace == "-" else open(args.trace)
+    with source:
+        trace = parse_trace(source)
+    if not trace.records:
+        sys.exit("no trace records found in %s" % args.trace)
+
+    counts = collections.Counter(op for op, _, _, _ in trace.records)
+    print("%d records (%s), %d lost before the oldest one" %
+          (len(trace.records), " ".join("%s:%d" % (op, counts[op]) for op in OPS if counts[op]), trace.lost))
+    print("density %s Kbit, capture span %d us" %
+          (trace.density if trace.density is not None else "?", capture_span(trace)))
+
+    heatmap(trace, args.region, args.width)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])